@@ -0,0 +1,31 @@
+// Page through a file of any size, press end to follow it while it grows.
+// syntax: ./page file
+
+#include "../tim.h"
+
+int main(int argc, char** argv) {
+    if (argc < 2 || strcmp(argv[1], "-h") == 0) {
+        printf("syntax: %s file\n", argv[0]);
+        exit(1);
+    }
+
+    struct pager* p = pager_open(argv[1]);
+    if (!p) {
+        perror(argv[1]);
+        exit(1);
+    }
+    tim.focus = (uintptr_t)p; // keys scroll without a click first
+
+    while (tim_run(0)) {
+        char buf[64];
+        pager(p, 0, 0, ~0, ~1, 0xf);
+        sprintf(buf, " %s, line %lld of %lld%s", argv[1],
+                (long long)p->top + 1, (long long)p->total,
+                p->follow ? ", following" : "");
+        label(buf, 0, ~0, ~0, 1, 0xf0);
+        if (is_key_press('q')) {
+            break;
+        }
+    }
+    pager_close(p);
+}
@@ -0,0 +1,37 @@
+// Serve a small dashboard to many terminals from one process.
+// syntax: ./serve /tmp/tim.sock
+// connect with: socat UNIX-CONNECT:/tmp/tim.sock STDIO,raw,echo=0
+
+#include "../tim.h"
+
+static struct server srv;
+
+int main(int argc, char** argv) {
+    if (argc < 2 || strcmp(argv[1], "-h") == 0) {
+        printf("syntax: %s socket\n", argv[0]);
+        exit(1);
+    }
+
+    if (!serve_listen(&srv, argv[1])) {
+        perror(argv[1]);
+        exit(1);
+    }
+
+    // one pass for each session that received an event or frame
+    while (serve_run(&srv, 1)) {
+        char buf[64];
+        scope (A, A, 32, 8) {
+            frame(0, 0, ~0, ~0, 0x8);
+            sprintf(buf, "sessions: %d", srv.count);
+            label(buf, 2, 1, A, A, 0xf);
+            sprintf(buf, "screen  : %dx%d", tim.w, tim.h);
+            label(buf, 2, 2, A, A, 0xf);
+            sprintf(buf, "frame   : %d", tim.frame);
+            label(buf, 2, 3, A, A, 0xf);
+            if (button("Quit", A, ~1, A, A, 0x9000f) ||
+                is_key_press('q') || is_key_press(ESCAPE_KEY)) {
+                serve_drop(&srv);
+            }
+        }
+    }
+}
@@ -0,0 +1,180 @@
+// Renderer and element benchmarks on a headless context. Prints one json
+// object per scenario. Run with: make bench
+
+#include "../tim.h"
+
+#define W      120  // screen width
+#define H      40   // screen height
+#define FRAMES 2000 // frames per scenario
+
+// every cell changes every frame
+static void full_redraw(int f) {
+    for (int y = 0; y < H; y++) {
+        draw_row(cell((f & 1) ? "x" : "o", 0xf, y), 0, y, W);
+    }
+}
+
+// one cell changes every frame
+static void single_cell(int f) {
+    label("static text on a static screen", 2, 2, A, A, 0xf);
+    draw_chr(cell("#", f & 0xff, 0), f % W, H / 2);
+}
+
+// log lines scroll up by one every frame
+static void scrolling_log(int f) {
+    char buf[64];
+    for (int y = 0; y < H; y++) {
+        sprintf(buf, "%08d log message with some text", f + y);
+        label(buf, 0, y, W, 1, 0xf);
+    }
+}
+
+// every cell has its own color, shifting every frame
+static void color_palette(int f) {
+    for (int y = 0; y < H; y++) {
+        for (int x = 0; x < W; x++) {
+            draw_chr(cell(" ", 0, (x + y + f) & 0xff), x, y);
+        }
+    }
+}
+
+// rows of double width characters scroll horizontally
+static void cjk_text(int f) {
+    static const char* s = "圍棋棋盤上的黑白子漢字한국어日本語のテキスト";
+    for (int y = 0; y < H; y++) {
+        label(s, (f + y) % W - W / 2, y, A, A, 0xf);
+    }
+}
+
+// 10k labels, most of them outside the screen
+static void label_table(int f) {
+    char buf[16];
+    for (int i = 0; i < 10000; i++) {
+        sprintf(buf, "%d", i + f);
+        label(buf, (i % 10) * 12, i / 10, 11, 1, 0xf);
+    }
+}
+
+// 10k labels that change every 100 frames, cached in between
+static void cached_table(int f) {
+    cached_scope (f / 100, 0, 0, ~0, ~0) {
+        label_table(f / 100 * 100);
+    }
+}
+
+static void bench_row(int i, bool selected, void* data) {
+    char buf[16];
+    (void)data;
+    sprintf(buf, "%d", i);
+    label(buf, 0, 0, ~0, 1, selected ? 0xf0 : 0xf);
+}
+
+// list of 10M rows scrolling by one row every frame
+static void list_10m(int f) {
+    static struct list l;
+    l.top = f;
+    list(&l, 10000000, bench_row, NULL, 0, 0, ~0, ~0, 0x8);
+}
+
+static char bench_values[100000][12];
+
+static const char* bench_text(int row, int col, void* data) {
+    (void)data;
+    (void)col;
+    return bench_values[row];
+}
+
+// table of 100k rows sorted by value, one row moves into view every frame
+static void sorted_table(int f) {
+    static struct column cols[] = {{"Value", A}, {"Copy", A}};
+    static struct table  t = {.columns = cols, .cols = 2, .text = bench_text,
+                              .sort = 1};
+    if (f == 0) {
+        for (int i = 0; i < 100000; i++) {
+            sprintf(bench_values[i], "%d", (i * 7919) % 100000);
+        }
+    }
+    sprintf(bench_values[(f * 31) % 100000], "%d", f % 50);
+    table_changed(&t, (f * 31) % 100000);
+    table(&t, 100000, f, 0, 0, ~0, ~0, 0xf0008);
+}
+
+// chart of the last 1M samples, 1000 samples pushed every frame
+static void live_chart(int f) {
+    static struct chart c = {.size = 1000000};
+    static float        v[1000];
+    for (int i = 0; i < 1000; i++) {
+        v[i] = (f * 1000 + i) % 7919;
+    }
+    chart_push(&c, v, 1000);
+    chart(&c, 0, 0, ~0, ~0, 0xf);
+}
+
+// static content while the screen size alternates
+static void resize(int f) {
+    (void)f;
+    label("resize", A, A, A, A, 0xf);
+    frame(0, 0, ~0, ~0, 0x8);
+}
+
+static void run(const char* name, void (*draw)(int), bool resizes) {
+    static struct event script[FRAMES];
+    for (int i = 0; i < FRAMES; i++) {
+        bool odd  = resizes && (i & 1);
+        script[i] = (struct event){
+            .type = DRAW_EVENT,
+            .x    = resizes ? W - odd * 10 : 0,
+            .y    = resizes ? H - odd * 5 : 0,
+        };
+    }
+
+    struct state*   s      = tim_headless(W, H);
+    int64_t         frames = 0;
+    int64_t         start  = 0;
+    struct counters sum    = {0};
+    context (s) {
+        tim_script(script, FRAMES);
+        while (tim_run(0)) {
+            if (frames == 1) {
+                // first frame is always a full repaint, skip it
+                start = time_us();
+            }
+            if (frames > 1) {
+                struct counters* st = &tim.stats.last;
+                sum.bytes          += st->bytes;
+                sum.writes         += st->writes;
+                sum.cells_emitted  += st->cells_emitted;
+                sum.cursor_moves   += st->cursor_moves;
+                sum.sgr_changes    += st->sgr_changes;
+                sum.encode_us      += st->encode_us;
+            }
+            draw(frames);
+            frames += 1;
+        }
+        int64_t ns = (time_us() - start) * 1000;
+        int64_t n  = MAX(frames - 2, 1);
+        printf("{\"name\": \"%s\", \"frames\": %d, \"ns_per_frame\": %d, "
+               "\"encode_ns_per_frame\": %d, \"bytes_per_frame\": %d, "
+               "\"writes_per_frame\": %.2f, \"cells_per_frame\": %d, "
+               "\"moves_per_frame\": %d, \"sgr_per_frame\": %d}\n",
+               name, (int)n, (int)(ns / n), (int)(sum.encode_us * 1000 / n),
+               (int)(sum.bytes / n), (double)sum.writes / n,
+               (int)(sum.cells_emitted / n), (int)(sum.cursor_moves / n),
+               (int)(sum.sgr_changes / n));
+    }
+    tim_close(s);
+}
+
+int main(void) {
+    run("full_redraw", full_redraw, false);
+    run("single_cell", single_cell, false);
+    run("scrolling_log", scrolling_log, false);
+    run("color_palette", color_palette, false);
+    run("cjk_text", cjk_text, false);
+    run("label_table", label_table, false);
+    run("cached_table", cached_table, false);
+    run("list_10m", list_10m, false);
+    run("sorted_table", sorted_table, false);
+    run("live_chart", live_chart, false);
+    run("resize", resize, true);
+}
@@ -0,0 +1,805 @@
+// Test renderer against the emulated screen of a headless context.
+
+#include "../tim.h"
+
+#define TEST(t) printf("\33[3%s\33[0m %s\n", (t) ? "2mpass" : "1mfail", #t)
+
+static struct edit ed = {.init = "edit"};
+static int         chk;
+static int         rad;
+static int         clicks;
+static struct profile prof;
+static int         cached;
+
+static int rows;
+
+// close peer of a session once its output backed up
+static void hang_up(void* fd) {
+    sleep_us(50000);
+    close(*(int*)fd);
+}
+
+static void row(int i, bool selected, void* data) {
+    char buf[16];
+    sprintf(buf, "%d", i);
+    label(buf, 0, 0, ~0, 1, selected ? 0xf0 : *(int*)data);
+    rows += 1;
+}
+
+static char names[1000][16];
+static char values[1000][16];
+
+static const char* cell_text(int row, int col, void* data) {
+    (void)data;
+    return col ? values[row] : names[row];
+}
+
+static char files[200000][16];
+
+static const char* file_name(int i, void* data) {
+    (void)data;
+    return files[i];
+}
+
+static int count_matches(const char* q) {
+    int n = 0;
+    for (int i = 0; i < 200000; i++) {
+        const char* a = q;
+        for (const char* b = files[i]; *a && *b; b++) {
+            a += *a == *b;
+        }
+        n += !*a;
+    }
+    return n;
+}
+
+// call filter until its scan is done
+static void run_filter(struct filter* f, struct edit* q) {
+    filter(f, q, 200000, 0, 0, 20, 10, 0xf);
+    for (int i = 0; i < 1000 && !f->done; i++) {
+        sleep_us(1000);
+        filter(f, q, 200000, 0, 0, 20, 10, 0xf);
+    }
+}
+
+static int loads;
+
+// root has 1000 folders with 1000 files each, folder 7 loads in background
+static bool load_node(struct tree* t, int node, void* data) {
+    char     buf[32];
+    uint64_t id = t->nodes[node].id;
+    (void)data;
+    loads += 1;
+    if (id == 7) {
+        return false;
+    }
+    for (int i = 0; i < 1000; i++) {
+        sprintf(buf, id ? "file %d" : "dir %d", i);
+        tree_add(t, node, buf, id ? 0 : i + 1, !id);
+    }
+    return true;
+}
+
+#ifdef TIM_TRACE
+struct dumped {
+    char    name[32];
+    int64_t ts;
+    int64_t dur;
+};
+
+static struct dumped spans[MAX_TRACE + 1];
+
+// dump trace and parse spans that started at or after since, -1 if malformed
+static int dump_spans(int64_t since) {
+    FILE* f = tmpfile();
+    trace_dump(f);
+    rewind(f);
+    char line[128];
+    int  n  = 0;
+    bool ok = fgets(line, sizeof(line), f) &&
+              !strcmp(line, "{\"traceEvents\": [\n");
+    while (ok && fgets(line, sizeof(line), f) && line[0] == '{') {
+        struct dumped d   = {0};
+        long long     ts  = 0;
+        long long     dur = 0;
+        int           tid = 0;
+        ok = sscanf(line, "{\"name\": \"%31[^\"]\", \"ph\": \"X\", \"pid\": 1, "
+                          "\"tid\": %d, \"ts\": %lld, \"dur\": %lld}",
+                    d.name, &tid, &ts, &dur) == 4 && tid > 0 && dur >= 0;
+        d.ts  = ts;
+        d.dur = dur;
+        if (ok && ts >= since && n <= MAX_TRACE) {
+            spans[n++] = d;
+        }
+    }
+    ok = ok && !strcmp(line, "]}\n");
+    fclose(f);
+    return ok ? n : -1;
+}
+#endif
+
+static bool is_sorted(struct table* t) {
+    for (int i = 1; i < t->count; i++) {
+        int a = atoi(values[t->order[i - 1]]);
+        int b = atoi(values[t->order[i]]);
+        if (t->sort > 0 ? a > b : a < b) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void ui(void) {
+    char buf[64];
+    sprintf(buf, "frame %d, %dx%d", tim.frame, tim.w, tim.h);
+    label(buf, 1, 0, A, A, 0xf);
+    label("multi\nliñe\nlabël", ~1, 1, A, A, 0x0f05);
+    label("圍棋56789 $£ह€𐍈", 1, ~0, A, A, 0x0f05);
+    named_scope ("form", 1, 2, 30, 12) {
+        frame(0, 0, ~0, ~0, 0x8);
+        if (button("Click", 1, 1, A, A, 0xa000f)) {
+            clicks += 1;
+        }
+        edit(&ed, 1, 4, ~1, 0xff00ff);
+        check("Check", &chk, 1, 7, A, 0xa000f);
+        radio("Radio 1", &rad, 1, 1, 8, A, 0xa000f);
+        radio("Radio 2", &rad, 2, 14, 8, A, 0xa000f);
+    }
+    cached_scope (clicks, 33, 2, 20, 3) {
+        cached += (tim.event.type == DRAW_EVENT);
+        frame(0, 0, ~0, ~0, 0x8);
+        sprintf(buf, "%d clicks", clicks);
+        label(buf, 1, 1, A, A, 0xf);
+    }
+}
+
+int main(void) {
+    struct event script[] = {
+        {.type = DRAW_EVENT},
+        {.type = MOUSE_EVENT, .key = LEFT_BUTTON, .x = 4, .y = 4},  // button
+        {.type = MOUSE_EVENT, .key = LEFT_BUTTON, .x = 4, .y = 7},  // edit
+        {.type = KEY_EVENT, .key = 'x', .str = "x"},
+        {.type = KEY_EVENT, .key = LEFT_KEY},
+        {.type = KEY_EVENT, .key = 0xe4, .str = "ä"},
+        {.type = KEY_EVENT, .key = ENTER_KEY},
+        {.type = MOUSE_EVENT, .key = LEFT_BUTTON, .x = 3, .y = 9},  // check
+        {.type = MOUSE_EVENT, .key = LEFT_BUTTON, .x = 16, .y = 10}, // radio
+        {.type = DRAW_EVENT, .x = 70, .y = 24},                      // width
+        {.type = DRAW_EVENT},
+        {.type = DRAW_EVENT, .x = 70, .y = 20},                      // height
+        {.type = DRAW_EVENT, .x = 90, .y = 30},                      // both
+        {.type = DRAW_EVENT, .x = 40, .y = 30},                      // width
+        {.type = DRAW_EVENT},
+    };
+
+    struct state* s = tim_headless(80, 24);
+    int draws  = 0;
+    int checks = 0;
+    int bad    = 0;
+    FILE* rec = tmpfile();
+    context (s) {
+        tim.profile = &prof;
+        tim_record(rec);
+        tim_script(script, ARRAY_SIZE(script));
+        while (tim_run(0)) {
+            int d = vt_check();
+            checks += (d >= 0);
+            bad    += (d > 0) || (d < 0 && !tim.resized && tim.frame > 0);
+            draws  += (tim.event.type == DRAW_EVENT);
+            ui();
+        }
+        TEST(vt_check() == 0);
+        TEST(tim.w == 40 && tim.h == 30);
+        TEST(tim.latency[KEY_LATENCY].count == 4);
+        TEST(tim.latency[MOUSE_LATENCY].count == 4);
+        TEST(tim.latency[RESIZE_LATENCY].count == 4);
+        TEST(latency_percentile(KEY_LATENCY, 100) == tim.latency[0].max);
+        TEST(cached == 6); // first frame, click and four resizes
+        TEST(prof.count == 7); // form and six kinds of elements
+        struct probe* form = &prof.probes[1]; // label is first
+        TEST(!strcmp(form->name, "form"));
+        TEST(form->last_calls == 1 && form->rect.w == 30);
+    }
+
+    TEST(s != NULL);
+    TEST(bad == 0);
+    TEST(checks > 10);
+    TEST(draws == (int)ARRAY_SIZE(script) + 1);
+    TEST(clicks == 1);
+    TEST(!strcmp(edit_str(&ed), "editäx"));
+    TEST(chk == 1);
+    TEST(rad == 2);
+
+    // replay recorded session into fresh state
+    struct state* r = tim_headless(80, 24);
+    edit_free(&ed);
+    chk    = rad = clicks = 0;
+    rewind(rec);
+    FILE* cast = tmpfile();
+    context (r) {
+        tim.cast = cast_open(cast);
+        tim_replay(rec, true);
+        while (tim_run(0)) {
+            ui();
+        }
+        cast_close(tim.cast);
+    }
+    TEST(r->vt->bytes == s->vt->bytes && r->vt->writes == s->vt->writes);
+    TEST(!memcmp(r->vt->cells, s->vt->cells, 40 * 30 * sizeof(struct cell)));
+    TEST(clicks == 1 && chk == 1 && rad == 2);
+
+    // asciicast of replay, header and one line per frame and resize
+    char line[64];
+    int  lines = 0;
+    rewind(cast);
+    TEST(fgets(line, sizeof(line), cast) && strstr(line, "\"version\": 2"));
+    for (int c = 0; (c = fgetc(cast)) != EOF;) {
+        lines += c == '\n';
+    }
+    TEST(lines > 1 + 4); // frames without changes are not recorded
+    fclose(cast);
+    // output is escaped as json, invalid utf8 is replaced
+    FILE* esc = tmpfile();
+    cast_escape(esc, S("a\xff€\xed\xa0\x80\"\1\xf0\x9f"));
+    rewind(esc);
+    TEST(fgets(line, sizeof(line), esc) &&
+         !strcmp(line, "\"a\\ufffd€\\ufffd\\ufffd\\ufffd\\\"\\u0001"
+                       "\\ufffd\\ufffd\""));
+    fclose(esc);
+    fclose(rec);
+
+    // canvas drawn by elements, scrolled, copied and blitted with clipping
+    struct canvas cv;
+    TEST(canvas_init(&cv, 8, 3));
+    context (r) {
+        tim.event.type = DRAW_EVENT;
+        canvas (&cv) {
+            label("abcdefgh", 0, 0, A, A, 0xf);
+            label("ABCDEFGH", 0, 1, A, A, 0xf);
+        }
+        canvas_scroll(&cv, 2, 1, cell(".", 0, 0));
+        canvas_copy(&cv, 0, 0, &cv, 2, 1, 6, 1);
+        TEST(!memcmp(cv.cells[0].buf, "a", 2) && cv.cells[7].buf[0] == '.');
+        TEST(cv.cells[8 + 2].buf[0] == 'a' && cv.cells[16 + 2].buf[0] == 'A');
+        TEST(cv.cells[16].buf[0] == '.' && tim.w == 40 && tim.scope == 0);
+        blit(&cv, 3, 0, 0, 0, A, A);
+        blit(&cv, 0, 0, 38, 1, 4, 1);
+        TEST(tim.cells[0].buf[0] == 'd' && tim.cells[4].buf[0] == '.');
+        TEST(tim.cells[40 + 38].buf[0] == 'a' && tim.cells[40 + 39].buf[0] == 'b');
+        // scrolling inside its own canvas block keeps the screen
+        canvas (&cv) {
+            canvas_scroll(&cv, -1, -1, cell(",", 0, 0));
+            label("xy", 0, 0, A, A, 0xf);
+        }
+        TEST(!memcmp(cv.cells[0].buf, "x", 2) && cv.cells[16].buf[0] == ',');
+        TEST(cv.cells[7].buf[0] == ',' && tim.w == 40 && tim.scope == 0);
+        blit(&cv, 0, 0, 0, 2, 2, 1);
+        TEST(tim.cells[80].buf[0] == 'x' && tim.cells[81].buf[0] == 'y');
+    }
+    canvas_free(&cv);
+
+    // stats average and maximum move with each frame
+    context (r) {
+        tim.stats = (struct stats){0};
+        for (int i = 1; i <= MAX_STATS + 6; i++) {
+            tim.stats.frame.bytes = i;
+            update_stats();
+        }
+        TEST(tim.stats.last.bytes == 70 && tim.stats.max.bytes == 70);
+        TEST(tim.stats.avg.bytes == (7 + 70) / 2);
+    }
+
+    // percentiles use the nearest rank, 99th of 50 samples is the largest
+    context (r) {
+        struct latency* l = &tim.latency[KEY_LATENCY];
+        latency_reset(KEY_LATENCY);
+        l->count                          = 50;
+        l->max                            = 90000;
+        l->buckets[latency_bucket(100)]   = 49;
+        l->buckets[latency_bucket(90000)] = 1;
+        TEST(latency_percentile(KEY_LATENCY, 99) == 90000);
+        TEST(latency_percentile(KEY_LATENCY, 98) < 1000);
+        TEST(latency_percentile(KEY_LATENCY, 0) < 1000);
+        latency_reset(KEY_LATENCY);
+    }
+
+    // scopes entered before the profiler was attached charge no probe
+    struct profile late = {0};
+    context (r) {
+        tim.event.type = DRAW_EVENT;
+        scope (0, 0, 10, 1) {
+            tim.profile = &late;
+            label("late", 0, 0, A, A, 0xf);
+        }
+        tim.profile = NULL;
+        TEST(late.count == 1 && late.probes[0].calls == 1);
+    }
+
+    // cached scopes in a loop keep the cells of each item
+    context (r) {
+        int runs = 0;
+        for (int f = 0; f < 2; f++) {
+            tim.event.type = DRAW_EVENT;
+            for (int i = 0; i < 3; i++) {
+                cached_scope (i, 0, i, 10, 1) {
+                    runs += 1;
+                    label(i ? "b" : "a", 0, 0, A, A, 0xf);
+                }
+            }
+        }
+        TEST(runs == 3 && tim.cells[0].buf[0] == 'a');
+        TEST(tim.cells[40].buf[0] == 'b' && tim.cells[80].buf[0] == 'b');
+    }
+
+    // nested scopes clip drawing and mouse input to the visible area
+    context (r) {
+        tim.event.type = DRAW_EVENT;
+        draw_lot(cell(".", 0, 0), 0, 0, tim.w, tim.h);
+        scope (10, 5, 4, 2) {
+            scope (2, 1, 8, 8) {
+                label("abcdefgh", 0, 0, A, A, 0xf);
+                label("ABCDEFGH", 0, 1, A, A, 0xf);
+                TEST(is_clipped(abs_xywh(0, 1, 8, 1)));
+            }
+        }
+        struct cell* c = &tim.cells[12 + 6 * tim.w];
+        TEST(c[-3].buf[0] == '.' && c[0].buf[0] == 'a' && c[1].buf[0] == 'b');
+        TEST(c[2].buf[0] == '.' && c[tim.w].buf[0] == '.');
+        tim.event = (struct event){MOUSE_EVENT, LEFT_BUTTON, .x = 3, .y = 5};
+        scope (0, 0, 4, 4) {
+            TEST(!button("Hidden", 2, 4, A, A, 0));
+        }
+        TEST(button("Shown", 2, 4, A, A, 0));
+    }
+
+    // list of 10M rows only draws visible rows, navigation is independent of
+    // row count
+    struct list   lst   = {0};
+    int           color = 0xf;
+    struct event  wheel = {.str = "\33[<64;5;6M"};
+    TEST(parse_input(&wheel, 11) && wheel.key == WHEEL_UP && wheel.y == 5);
+    context (r) {
+        tim.event.type = DRAW_EVENT;
+        list(&lst, 10000000, row, &color, 2, 2, 10, 5, 0x8);
+        TEST(rows == 5 && tim.cells[2 + 3 * tim.w].buf[0] == '1');
+        tim.event = (struct event){MOUSE_EVENT, LEFT_BUTTON, .x = 3, .y = 4};
+        TEST(list(&lst, 10000000, row, &color, 2, 2, 10, 5, 0x8));
+        TEST(lst.selected == 2 && tim.focus == (uintptr_t)&lst);
+        tim.event = (struct event){KEY_EVENT, END_KEY};
+        list(&lst, 10000000, row, &color, 2, 2, 10, 5, 0x8);
+        TEST(lst.selected == 9999999 && lst.top == 9999995);
+        tim.event = (struct event){MOUSE_EVENT, WHEEL_UP, .x = 3, .y = 4};
+        list(&lst, 10000000, row, &color, 2, 2, 10, 5, 0x8);
+        TEST(lst.top == 9999992 && tim.event.type == VOID_EVENT);
+        tim.event = (struct event){MOUSE_EVENT, LEFT_BUTTON, .x = 11, .y = 2};
+        list(&lst, 10000000, row, &color, 2, 2, 10, 5, 0x8);
+        TEST(lst.top == 0 && lst.selected == 9999999);
+        tim.event.type = DRAW_EVENT;
+        rows = 0;
+        scope (0, 0, ~0, 4) {
+            list(&lst, 10000000, row, &color, 2, 2, 10, 5, 0x8);
+        }
+        TEST(rows == 2 && tim.cells[11 + 2 * tim.w].buf[0] == 0xe2);
+    }
+
+    // table with automatic widths, header click sorts, resort after update
+    static struct column cols[] = {{"Name", A}, {"Value", 6}};
+    struct table tbl = {.columns = cols, .cols = 2, .text = cell_text};
+    for (int i = 0; i < 1000; i++) {
+        sprintf(names[i], "row %d", i);
+        sprintf(values[i], "%d", (i * 7919) % 1000);
+    }
+    context (r) {
+        tim.event.type = DRAW_EVENT;
+        table(&tbl, 1000, 1, 0, 0, 20, 10, 0xf0008);
+        TEST(tbl.widths[0] == 7 && tbl.widths[1] == 6 && tbl.order[3] == 3);
+        TEST(!memcmp(tim.cells[8].buf, "V", 1) && tim.cells[40].buf[0] == 'r');
+        tim.event = (struct event){MOUSE_EVENT, LEFT_BUTTON, .x = 9, .y = 0};
+        table(&tbl, 1000, 1, 0, 0, 20, 10, 0xf0008);
+        TEST(tbl.sort == 2 && is_sorted(&tbl) && !strcmp(values[tbl.order[0]], "0"));
+        table(&tbl, 1000, 1, 0, 0, 20, 10, 0xf0008);
+        TEST(tbl.sort == -2 && is_sorted(&tbl) && !strcmp(values[tbl.order[0]], "999"));
+        tbl.list.selected = 5;
+        int row = tbl.order[5];
+        strcpy(values[tbl.order[900]], "1500");
+        tim.event.type = DRAW_EVENT;
+        table(&tbl, 1000, 2, 0, 0, 20, 10, 0xf0008);
+        TEST(is_sorted(&tbl) && !strcmp(values[tbl.order[0]], "1500"));
+        TEST(tbl.order[tbl.list.selected] == row && tbl.list.selected == 6);
+        int moved = tbl.order[10];
+        strcpy(values[moved], "123456789");
+        strcpy(names[moved], "row moved up");
+        table_changed(&tbl, moved);
+        table(&tbl, 1000, 2, 0, 0, 20, 10, 0xf0008);
+        TEST(is_sorted(&tbl) && tbl.order[0] == moved && tbl.widths[0] == 12);
+        TEST(tbl.order[tbl.list.selected] == row && tbl.nchanged == 0);
+        sprintf(names[moved], "row %d", moved);
+        table(&tbl, 500, 3, 0, 0, 20, 10, 0xf0008);
+        TEST(tbl.count == 500 && is_sorted(&tbl) && tbl.widths[0] == 7);
+        // sort arrow past the last column stays within the table
+        label("x", 14, 0, A, A, 0xf);
+        table(&tbl, 500, 3, 0, 0, 14, 10, 0xf0008);
+        TEST(tim.cells[14].buf[0] == 'x' && !memcmp(tim.cells[8].buf, "V", 1));
+        table(&tbl, 500, 3, 0, 0, 15, 10, 0xf0008);
+        TEST(!memcmp(tim.cells[14].buf, "▼", 4));
+    }
+    table_free(&tbl);
+
+    // edit without size limit, moves across the gap and scrolls to cursor
+    struct edit long_ed = {.init = "äb"};
+    context (r) {
+        tim.focus = (uintptr_t)&long_ed;
+        for (int i = 0; i < 1000; i++) {
+            tim.event = (struct event){KEY_EVENT, 'x', .str = "x"};
+            edit(&long_ed, 0, 0, 10, 0xff00ff);
+        }
+        int keys[] = {HOME_KEY, RIGHT_KEY, BACKSPACE_KEY, DELETE_KEY, END_KEY};
+        for (int i = 0; i < 5; i++) {
+            tim.event = (struct event){KEY_EVENT, keys[i]};
+            edit(&long_ed, 0, 0, 10, 0xff00ff);
+        }
+        tim.event = (struct event){KEY_EVENT, 0xe9, .str = "é"};
+        edit(&long_ed, 0, 0, 10, 0xff00ff);
+        TEST(long_ed.length == 1001 && long_ed.cursor == 1001);
+        tim.event.type = DRAW_EVENT;
+        edit(&long_ed, 0, 0, 10, 0xff00ff);
+        TEST(long_ed.scroll == 995 && !memcmp(tim.cells[40 + 7].buf, "é", 2));
+        const char* str = edit_str(&long_ed);
+        TEST(strlen(str) == 1002 && str[0] == 'x' && !strcmp(str + 999, "xé"));
+    }
+    edit_free(&long_ed);
+
+    // textarea edits pieces, moves by line and draws visible lines only
+    struct textarea ta = {.str = "first\nsecond line\nthird", .size = 12};
+    context (r) {
+        tim.event = (struct event){MOUSE_EVENT, LEFT_BUTTON, .x = 5, .y = 2};
+        textarea(&ta, 0, 0, 20, 4, 0xff00ff);
+        TEST(tim.focus == (uintptr_t)&ta && ta.cursor == 9);
+        struct event keys[] = {
+            {KEY_EVENT, 'X', .str = "X"},  {KEY_EVENT, ENTER_KEY},
+            {KEY_EVENT, UP_KEY},           {KEY_EVENT, UP_KEY},
+            {KEY_EVENT, END_KEY},          {KEY_EVENT, DELETE_KEY},
+            {KEY_EVENT, PAGEDOWN_KEY},     {KEY_EVENT, BACKSPACE_KEY},
+        };
+        for (int i = 0; i < 8; i++) {
+            tim.event = keys[i];
+            textarea(&ta, 0, 0, 20, 4, 0xff00ff);
+        }
+        char buf[32] = {0};
+        TEST(textarea_read(&ta, 0, buf, sizeof(buf)) == 12);
+        TEST(!strcmp(buf, "firstsecX\non") && textarea_lines(&ta) == 2);
+        tim.event.type = DRAW_EVENT;
+        textarea(&ta, 0, 0, 20, 4, 0xff00ff);
+        TEST(ta.top == 0 && ta.cursor == 12 && tim.cells[40 + 2].buf[0] == 'f');
+        TEST(tim.cells[80 + 3].buf[0] == 'n' && tim.cells[80 + 4].buf[0] == ' ');
+    }
+    textarea_free(&ta);
+
+    // pager indexes file in background and follows it while it grows
+    char  path[] = "/tmp/tim-pager-XXXXXX";
+    FILE* log    = fdopen(mkstemp(path), "w");
+    for (int i = 0; i < 100000; i++) {
+        fprintf(log, "line\t%d\n", i);
+    }
+    fflush(log);
+    struct pager* pg = NULL;
+    struct state* ps = tim_headless(40, 20);
+    context (ps) {
+        pg = pager_open(path);
+        TEST(pg != NULL);
+        // count belongs to the indexer, total is its value when last drawn
+        int posts = 0;
+        for (int i = 0; i < 100 && pg->total < 100000; i++) {
+            sleep_us(10000);
+            while (tim_run(0)) {
+                posts += tim.event.type == USER_EVENT && tim.event.data == pg;
+            }
+            tim.event.type = DRAW_EVENT;
+            pager(pg, 0, 0, 20, 10, 0xf);
+        }
+        TEST(pg->total == 100000 && posts > 0);
+        TEST(!memcmp(tim.cells[0].buf, "l", 2) && tim.cells[4].buf[0] == ' ');
+        TEST(tim.cells[40 * 9 + 5].buf[0] == '9' && tim.cells[40 * 10].buf[0] != 'l');
+        fputs("last\n", log);
+        fflush(log);
+        for (int i = 0; i < 100 && pg->total < 100001; i++) {
+            sleep_us(10000);
+            tim.event.type = DRAW_EVENT;
+            pager(pg, 0, 0, 20, 10, 0xf);
+        }
+        tim.event.type = DRAW_EVENT;
+        pg->follow     = true;
+        pager(pg, 0, 0, 20, 10, 0xf);
+        TEST(pg->top == 100001 - 10 && tim.cells[40 * 9].buf[0] == 'l');
+        TEST(tim.cells[40 * 9 + 1].buf[0] == 'a');
+        // a growing last line is posted although it adds no line
+        for (int k = 0; k < 2; k++) {
+            fputs(k ? "ed" : "tail", log);
+            fflush(log);
+            bool shown = false;
+            for (int i = 0; i < 100 && !shown; i++) {
+                sleep_us(10000);
+                while (tim_run(0)) {
+                    if (tim.event.type == USER_EVENT && tim.event.data == pg) {
+                        tim.event.type = DRAW_EVENT;
+                        pager(pg, 0, 0, 20, 10, 0xf);
+                        shown = tim.cells[40 * 9 + 3].buf[0] == 'l' &&
+                                tim.cells[40 * 9 + 5].buf[0] == (k ? 'd' : ' ');
+                    }
+                }
+            }
+            TEST(shown);
+        }
+        // truncated file is indexed again before it is drawn
+        TEST(!ftruncate(fileno(log), 0));
+        rewind(log);
+        fputs("short\nfile\n", log);
+        fflush(log);
+        int64_t count = 0;
+        for (int i = 0; i < 100 && count != 2; i++) {
+            sleep_us(10000);
+            monitor_lock(&pg->lock);
+            count = pg->count;
+            monitor_unlock(&pg->lock);
+        }
+        tim.event.type = DRAW_EVENT;
+        pager(pg, 0, 0, 20, 10, 0xf);
+        TEST(pg->total == 2 && pg->top == 0 && tim.cells[0].buf[0] == 's');
+        TEST(tim.cells[40].buf[0] == 'f' && tim.cells[80].buf[0] == ' ');
+    }
+    pager_close(pg);
+
+    // tree loads on expand and keeps visible rows in sync
+    struct tree tr = {.load = load_node};
+    context (ps) {
+        int root = tree_add(&tr, -1, "root", 0, true);
+        TEST(root == 0 && tr.nrows == 1 && loads == 0);
+        tim.focus = (uintptr_t)&tr.list;
+        tim.event = (struct event){KEY_EVENT, ' '};
+        tree(&tr, 0, 0, 20, 10, 0xf);
+        TEST(tr.nrows == 1001 && loads == 1 && tr.count == 1001);
+        tree_expand(&tr, 4, true);
+        TEST(tr.nrows == 2001 && tr.rows[5] == 1001 && tr.rows[1005] == 5);
+        tree_expand(&tr, 7, true);
+        TEST(tr.nrows == 2002 && tr.rows[1008] == -2 - 7);
+        int a = tree_add(&tr, 7, "late", 0, false);
+        tree_add(&tr, 7, "later", 0, false);
+        TEST(tr.nrows == 2002 && tr.nodes[7].state == TREE_LOADING);
+        tree_done(&tr, 7);
+        TEST(tr.nrows == 2003 && tr.rows[1008] == a && tr.rows[1010] == 8);
+        tr.list.selected = 1010;
+        tree_expand(&tr, 4, false);
+        TEST(tr.nrows == 1003 && tr.list.selected == 10 && tree_selected(&tr) == 8);
+        tim.event = (struct event){KEY_EVENT, LEFT_KEY};
+        tree(&tr, 0, 0, 20, 10, 0xf);
+        TEST(tree_selected(&tr) == root);
+        tim.event = (struct event){KEY_EVENT, LEFT_KEY};
+        tree(&tr, 0, 0, 20, 10, 0xf);
+        TEST(tr.nrows == 1 && !tr.nodes[root].expanded);
+        tim.event = (struct event){MOUSE_EVENT, LEFT_BUTTON, .x = 0, .y = 0};
+        tree(&tr, 0, 0, 20, 10, 0xf);
+        TEST(tr.nrows == 1003 && loads == 3);
+        tim.event = (struct event){KEY_EVENT, DOWN_KEY};
+        tree(&tr, 0, 0, 20, 10, 0xf);
+        tim.event = (struct event){KEY_EVENT, RIGHT_KEY};
+        tree(&tr, 0, 0, 20, 10, 0xf);
+        TEST(tr.nrows == 2003 && tr.nodes[1].expanded && tr.list.selected == 1);
+        tim.event.type = DRAW_EVENT;
+        tree(&tr, 0, 0, 20, 10, 0xf);
+        TEST(!memcmp(tim.cells[0].buf, "▾", 3) && tim.cells[2].buf[0] == 'r');
+        TEST(!memcmp(tim.cells[40 + 2].buf, "▾", 3) && tim.cells[80 + 6].buf[0] == 'f');
+    }
+    tree_free(&tr);
+
+    // chart merges pushed samples into cached buckets
+    struct chart ch = {.size = 1000};
+    float        ramp[1550];
+    for (int i = 0; i < 1550; i++) {
+        ramp[i] = i;
+    }
+    context (ps) {
+        TEST(chart_push(&ch, ramp, 1500));
+        tim.event.type = DRAW_EVENT;
+        chart(&ch, 0, 0, 10, 1, 0xf);
+        TEST(ch.per == 100 && ch.lo == 500 && ch.hi == 1499);
+        TEST(!memcmp(tim.cells[0].buf, "▁", 3) && !memcmp(tim.cells[9].buf, "█", 3));
+        chart_push(&ch, ramp + 1500, 50);
+        chart(&ch, 0, 0, 10, 1, 0xf);
+        TEST(ch.built == 1550 && ch.mins[5] == 1500 && ch.maxs[5] == 1549);
+        TEST(ch.lo == 600 && ch.hi == 1549 && !memcmp(tim.cells[0].buf, "▁", 3));
+        struct chart flat = {.size = 100};
+        float        one  = 1;
+        for (int i = 0; i < 100; i++) {
+            chart_push(&flat, &one, 1);
+        }
+        chart(&flat, 0, 2, 4, 2, 0xf);
+        TEST(!memcmp(tim.cells[120].buf, "⣀", 3) && !memcmp(tim.cells[123].buf, "⣀", 3));
+        TEST(tim.cells[80].buf[0] == ' ');
+        // lo + 1 == lo for huge samples, NaN compares false everywhere
+        float odd[2] = {1e30f, 0.0f / 0.0f};
+        for (int i = 0; i < 100; i++) {
+            chart_push(&flat, &odd[i / 50], 1);
+        }
+        chart(&flat, 0, 2, 4, 2, 0xf);
+        TEST(!memcmp(tim.cells[120].buf, "⣀", 3) && tim.cells[80].buf[0] == ' ');
+        chart_free(&flat);
+    }
+    chart_free(&ch);
+
+    // filter streams matches of a query and refines them when it is extended
+    for (int i = 0; i < 200000; i++) {
+        sprintf(files[i], i == 12345 ? "README.md" : "file_%d.c", i);
+    }
+    struct filter flt = {.item = file_name};
+    struct edit   q1  = {.init = "readme"};
+    struct edit   q2  = {.init = "f1999"};
+    struct edit   q3  = {.init = "f19999"};
+    context (ps) {
+        tim.event.type = DRAW_EVENT;
+        filter(&flt, &q1, 200000, 0, 0, 20, 10, 0xf);
+        run_filter(&flt, &q1);
+        TEST(flt.done && flt.matches == 1 && filter_selected(&flt) == 12345);
+        tim.event.type = DRAW_EVENT;
+        filter(&flt, &q2, 200000, 0, 0, 20, 10, 0xf);
+        TEST(flt.scan->cand == NULL);
+        run_filter(&flt, &q2);
+        TEST(flt.matches == count_matches("f1999"));
+        filter(&flt, &q3, 200000, 0, 0, 20, 10, 0xf);
+        TEST(flt.scan->cand && flt.scan->ncand == count_matches("f1999"));
+        run_filter(&flt, &q3);
+        TEST(flt.matches == count_matches("f19999") && flt.top[0].index == 19999);
+        TEST(flt.top_count == flt.matches && flt.top[1].index == 199990);
+        tim.event.type = DRAW_EVENT;
+        filter(&flt, &q3, 200000, 0, 0, 20, 10, 0xf);
+        TEST(!memcmp(tim.cells[0].buf, "f", 2) && tim.cells[5].buf[0] == '1');
+        tim.focus = (uintptr_t)&q3;
+        tim.event = (struct event){KEY_EVENT, DOWN_KEY};
+        filter(&flt, &q3, 200000, 0, 0, 20, 10, 0xf);
+        TEST(flt.list.selected == 1 && tim.focus == (uintptr_t)&q3);
+        tim.event = (struct event){KEY_EVENT, ENTER_KEY};
+        TEST(filter(&flt, &q3, 200000, 0, 0, 20, 10, 0xf));
+        TEST(filter_selected(&flt) == 199990);
+        int posts = 0;
+        while (tim_run(0)) {
+            posts += tim.event.type == USER_EVENT && tim.event.data == &flt;
+        }
+        TEST(posts > 0);
+        struct edit q4 = {.init = "FILE"};
+        run_filter(&flt, &q4);
+        TEST(flt.matches == 199999 && flt.top_count == MAX_MATCH);
+        TEST(flt.top[0].index == 0 && flt.top[MAX_MATCH - 1].index == 999);
+        edit_free(&q4);
+    }
+    filter_free(&flt);
+
+    // server session on a socketpair draws, reads input and ends on drop
+    struct server srv = {0};
+    int           sv[2];
+    char          out[8192];
+    int           keys = 0;
+    TEST(!socketpair(AF_UNIX, SOCK_STREAM, 0, sv));
+    TEST(serve_add(&srv, sv[0], sv[0]) != NULL);
+    TEST(write(sv[1], "x", 1) == 1);
+    while (serve_run(&srv, 0)) {
+        label("served", 0, 0, A, A, 0xf);
+        if (is_key_press('x')) {
+            keys += 1;
+            serve_drop(&srv);
+        }
+    }
+    int got = (int)recv(sv[1], out, sizeof(out) - 1, MSG_DONTWAIT);
+    out[MAX(got, 0)] = 0;
+    TEST(keys == 1 && srv.count == 0 && got > 0 && strstr(out, "served"));
+    close(sv[0]);
+    close(sv[1]);
+
+    // session whose peer hangs up while its output is backed up is removed
+    struct thread peer;
+    int           frames = 0;
+    int           small  = 4096;
+    TEST(!socketpair(AF_UNIX, SOCK_STREAM, 0, sv));
+    setsockopt(sv[0], SOL_SOCKET, SO_SNDBUF, &small, sizeof(small));
+    setsockopt(sv[1], SOL_SOCKET, SO_RCVBUF, &small, sizeof(small));
+    TEST(serve_add(&srv, sv[0], sv[0]) != NULL);
+    TEST(thread_start(&peer, hang_up, &sv[1]));
+    while (serve_run(&srv, 100)) {
+        for (int y = 0; y < tim.h; y++) {
+            char buf[32];
+            sprintf(buf, "frame %d row %d", tim.frame, y);
+            label(buf, y % 7, y, A, A, tim.frame + y);
+        }
+        frames += tim.event.type == DRAW_EVENT;
+    }
+    thread_join(&peer);
+    TEST(srv.count == 0 && frames > 1);
+    close(sv[0]);
+
+    // mirror paints viewers in full, then sends differences only
+    struct mirror mr = {0};
+    TEST(!socketpair(AF_UNIX, SOCK_STREAM, 0, sv));
+    context (ps) {
+        tim.mirror = &mr;
+        TEST(mirror_add(&mr, sv[0]));
+        tim.event.type = DRAW_EVENT;
+        draw_lot(cell(" ", 0, 0), 0, 0, tim.w, tim.h);
+        label("mirrored", 0, 0, A, A, 0xf);
+        render();
+        int full = (int)recv(sv[1], out, sizeof(out) - 1, MSG_DONTWAIT);
+        out[MAX(full, 0)] = 0;
+        TEST(full > 0 && strstr(out, "mirrored") && mr.viewers[0].base == 1);
+        draw_lot(cell(" ", 0, 0), 0, 0, tim.w, tim.h);
+        label("mirrorEd", 0, 0, A, A, 0xf);
+        render();
+        int part = (int)recv(sv[1], out, sizeof(out) - 1, MSG_DONTWAIT);
+        out[MAX(part, 0)] = 0;
+        TEST(part > 0 && part < full / 4 && strstr(out, "mirrorEd"));
+        // viewer that went away is dropped on the next write
+        close(sv[1]);
+        label("gone", 0, 1, A, A, 0xf);
+        render();
+        TEST(mr.count == 0);
+        tim.mirror = NULL;
+    }
+    for (int i = 0; i < MAX_HISTORY; i++) {
+        free(mr.history[i]);
+    }
+    for (int i = 0; i < (int)ARRAY_SIZE(mr.deltas); i++) {
+        free(mr.deltas[i].buf);
+    }
+    free(mr.scratch);
+
+#ifdef TIM_TRACE
+    // each pass of a traced frame encloses the user span drawn in it
+    struct state* ts     = tim_headless(20, 5);
+    struct event  draw[] = {{.type = DRAW_EVENT}, {.type = DRAW_EVENT}};
+    int64_t       since  = time_us();
+    int           passes = 0;
+    context (ts) {
+        tim_script(draw, ARRAY_SIZE(draw));
+        while (tim_run(0)) {
+            trace ("user") {
+                label("traced", 0, 0, A, A, 0xf);
+            }
+        }
+    }
+    int n     = dump_spans(since);
+    int users = 0;
+    int outer = 0;
+    for (int i = 0; i < n; i++) {
+        passes += !strcmp(spans[i].name, "draw pass") ||
+                  !strcmp(spans[i].name, "event pass");
+        if (!strcmp(spans[i].name, "user")) {
+            users += 1;
+            int64_t end = spans[i].ts + spans[i].dur;
+            for (int k = 0; k < n; k++) {
+                outer += strstr(spans[k].name, " pass") &&
+                         spans[k].ts <= spans[i].ts &&
+                         spans[k].ts + spans[k].dur >= end;
+            }
+        }
+    }
+    TEST(n > 0 && passes > 1 && users == passes && outer == users);
+    tim_close(ts);
+
+    // ring keeps the last MAX_TRACE spans after it wrapped around
+    since = time_us();
+    for (int i = 0; i < MAX_TRACE + 100; i++) {
+        trace ("wrap") {}
+    }
+    n         = dump_spans(0);
+    int wraps = 0;
+    for (int i = 0; i < n; i++) {
+        wraps += !strcmp(spans[i].name, "wrap") && spans[i].ts >= since;
+    }
+    TEST(n == MAX_TRACE && wraps == MAX_TRACE);
+#endif
+
+    edit_free(&q1);
+    edit_free(&q2);
+    edit_free(&q3);
+    tim_close(ps);
+    fclose(log);
+    remove(path);
+    tim_close(r);
+    tim_close(s);
+}
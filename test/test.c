@@ -1,5 +1,12 @@
 #include "../tim.h"
 
+static void list_row(int i, bool selected, void* data) {
+    char buf[32];
+    (void)data;
+    sprintf(buf, " row %d", i);
+    label(buf, 0, 0, ~0, 1, selected ? 0xf0 : 0xf);
+}
+
 static inline void test_screen(struct event* e) {
     static struct event me;
     static struct event ke;
@@ -46,7 +53,7 @@ static inline void test_screen(struct event* e) {
     label("multi\nliñe\nlabël", 24, 1, A, A, 0xf);
 
     // colors
-    scope (1, 5, 16, 5) {
+    named_scope ("colors", 1, 5, 16, 5) {
         frame(0, 0, ~0, ~0, 0xf);
         label(" Red   ", 1, 1, 7, A, 0x0900);
         label("       ", 8, 1, 7, A, 0xc400);
@@ -63,13 +70,13 @@ static inline void test_screen(struct event* e) {
     }
 
     // edit
-    static struct edit ed1 = {.str = "Edit 1"};
+    static struct edit ed1 = {.init = "Edit 1"};
     static struct edit ed2 = {0};
     edit(&ed1, 1, 10, 32, 0xff00ff);
     sprintf(buf, "cursor: %d length: %d", ed1.cursor, ed1.length);
     label(buf, 2, 13, A, A, 0xf);
     edit(&ed2, 1, 14, 32, 0xff00ff);
-    label(ed2.str, 2, 17, A, A, 0xf);
+    label(edit_str(&ed2), 2, 17, A, A, 0xf);
 
     // checkbox
     static int chk[2] = {-1, 1};
@@ -83,8 +90,12 @@ static inline void test_screen(struct event* e) {
     radio("Radio 3", &rad, 3,  1, 20, A, 0xa000f);
     radio("Radio 4", &rad, 4, 14, 20, A, 0xa000f);
 
+    // list with a million rows
+    static struct list lst;
+    list(&lst, 1000000, list_row, NULL, 34, 5, 20, 10, 0x8);
+
     // scope nesting
-    scope(~1, 1, 20, 10) {
+    named_scope ("nesting", ~1, 1, 20, 10) {
         scope(0, 0, 10, 5) {
             frame(0, 0, ~0, ~0, 0x9);
         }
@@ -109,8 +120,13 @@ static inline void test_screen(struct event* e) {
 }
 
 int main(void) {
+    static struct profile prof;
+    tim.profile = &prof;
     while (tim_run(1.5)) {
         test_screen(&tim.event);
+        if (is_key_press('p')) {
+            prof.overlay = !prof.overlay; // toggle profiler overlay
+        }
         if (is_key_press('q') || is_key_press(ESCAPE_KEY)) {
             break;
         }
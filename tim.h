@@ -32,6 +32,11 @@
 // with a for loop, so statements like break or return inside the scope block
 // will probably give you a bad time.
 //
+// Drawing and mouse input are clipped to the visible area of the scope, which
+// is the scope intersected with all its parents. Elements outside of it are
+// skipped before their content is measured, so long lists are cheap when only
+// a few rows fit.
+//
 // Elements (widget, control, component) are elements of user interaction, such
 // as a button or edit box. Most elements take x/y/w/h arguments to control
 // placement. All positions are given in relation the element's parent scope.
@@ -85,8 +90,30 @@
 // -------------|-----------------------
 //  DRAW_EVENT  | input, timeout, resize
 //  KEY_EVENT   | key press
-//  MOUSE_EVENT | mouse click
+//  MOUSE_EVENT | mouse click or wheel
 //  VOID_EVENT  | consumed event
+//  USER_EVENT  | post_event, data in tim.event.data
+
+/* contexts *******************************************************************/
+
+// All state lives in a context, struct state. The tim macro refers to the
+// current context of the calling thread, which initially is the default
+// context on stdin and stdout. Every element and function works on the current
+// context, so switching it is all it takes to drive several terminals, for
+// example ptys, from one process.
+//
+//     struct state* s = tim_open(fd, fd);    // context on another terminal
+//     context (s) {                          // make it current in block
+//         while (tim_run(10)) {              //
+//             label("Hi", A, A, A, A, 0xf);  //
+//         }                                  //
+//     }                                      //
+//     tim_close(s);                          //
+//
+// Contexts do not share anything except the signal handling, which belongs to
+// the default context. Other contexts poll their screen size on every event, so
+// they should run with a non-zero fps to notice resizes. Each context must only
+// be used by one thread at a time, apart from post_event.
 
 /* elements *******************************************************************/
 
@@ -117,13 +144,14 @@
 //
 // edit (state, x, y, w, color) -> bool
 //
-//     Draw text edit. Output is stored in state.str. Receives input events when
-//     focused by mouse click. Escape or return relinquish focus. Returns true
-//     when return is pressed.
+//     Draw text edit. The initial text is state.init, read the current text
+//     with edit_str. Text length is only limited by memory. Receives input
+//     events when focused by mouse click. Escape or return relinquish focus.
+//     Returns true when return is pressed.
 //
 //     state   pointer to persistent edit state struct
 //     x/y/w   see layout documentation
-//     color   f   rame, background, text
+//     color   frame, background, text
 //
 // check (str, state, x, y, w, color) -> bool
 //
@@ -147,6 +175,103 @@
 //     v       unique state value
 //     x/y/w   see layout documentation
 //     color   radio, background, text
+//
+// list (state, count, row, data, x, y, w, h, color) -> bool
+//
+//     Draw virtualized list of count rows. Only visible rows are drawn, by
+//     calling row (i, selected, data) inside a scope of the row, so the cost
+//     does not depend on count. A scroll bar is shown when rows don't fit.
+//     The wheel scrolls, a click selects a row and focuses the list. When
+//     focused, arrow, page, home and end keys move the selection and escape
+//     relinquishes focus. Returns true when a row is clicked or return is
+//     pressed.
+//
+//     state   pointer to persistent list state struct
+//     count   number of rows
+//     row     function drawing row i, selected is true for state.selected
+//     data    user pointer passed to row
+//     x/y/w/h see layout documentation
+//     color   background, scroll bar
+//
+// textarea (state, x, y, w, h, color) -> bool
+//
+//     Draw multi line text edit. The initial text is state.str with
+//     state.size bytes (0 for zero terminated), which is not copied and must
+//     stay valid. Edits go to a piece table that indexes newlines, so finding
+//     a line takes a binary search and only visible lines are read, even for
+//     huge texts. Focused by mouse click, which also places the cursor.
+//     Handles the keys of edit plus up, down, page up and page down. Return
+//     inserts a newline, escape relinquishes focus. The wheel scrolls. Returns
+//     true when the text changed.
+//
+//     state   pointer to persistent textarea state struct
+//     x/y/w/h see layout documentation
+//     color   frame, background, text
+//
+// table (state, count, key, x, y, w, h, color) -> bool
+//
+//     Draw table of count rows with a header line and a virtualized body,
+//     see list. Columns, cell text callback and data pointer are set in the
+//     state. Automatic column widths are computed from the data, and rows are
+//     sorted, only when key or count change. Sorting keeps a permutation in
+//     state.order, which is resorted incrementally. When the changed rows are
+//     passed to table_changed, only these are measured and moved to their
+//     place, so small changes to big tables are cheap. Automatic widths then
+//     only grow. A click on a header sorts by that column, another click
+//     reverses the order. The selection follows its data row, which is
+//     state.order[state.list.selected]. Returns true when a row is clicked or
+//     return is pressed.
+//
+//         static struct column cols[] = {{"PID", A}, {"Name", 20}};
+//         static struct table  t = {.columns = cols, .cols = 2, .text = f};
+//         table(&t, count, version, 0, 0, ~0, ~0, 0xf0008);
+//
+//     state   pointer to persistent table state struct
+//     count   number of data rows
+//     key     uint64 hash or version of data, change it when data changes
+//     x/y/w/h see layout documentation
+//     color   header, background, text
+//
+// tree (state, x, y, w, h, color) -> bool
+//
+//     Draw tree of nodes added with tree_add as a virtualized list, see list.
+//     Folders are loaded on first expand by calling state.load (state, node,
+//     data), which adds the children and returns true. To load in the
+//     background, load returns false, a placeholder row shows until tree_done
+//     is called. Visible rows are kept in state.rows and only change on
+//     expand and collapse, so drawing does not depend on the size of the
+//     tree. A click on the arrow expands or collapses a folder. When focused,
+//     right expands or moves to the first child, left collapses or moves to
+//     the parent, space toggles. Returns true when a row is clicked or return
+//     is pressed.
+//
+//         static struct tree t = {.load = load_dir};
+//         if (!t.count) {
+//             tree_add(&t, -1, "/", 0, true);
+//         }
+//         tree(&t, 0, 0, ~0, ~0, 0xf);
+//
+//     state   pointer to persistent tree state struct
+//     x/y/w/h see layout documentation
+//     color   background, text
+//
+// chart (state, x, y, w, h, color)
+//
+//     Draw the last state.size samples pushed with chart_push. A height of
+//     one draws a sparkline of blocks, larger heights draw a line of braille
+//     dots, 2x4 per cell. Samples are reduced to the minimum and maximum of
+//     each column. These are cached and only pushed samples are merged, so a
+//     frame does not depend on the window size. The value range is
+//     state.min to state.max, or the range of the shown samples when they are
+//     equal. The range of the last draw is state.lo to state.hi.
+//
+//         static struct chart c = {.size = 1000000};
+//         chart_push(&c, &cpu, 1);
+//         chart(&c, 0, 0, ~0, 8, 0xa);
+//
+//     state   pointer to persistent chart state struct
+//     x/y/w/h see layout documentation
+//     color   background, line
 
 /* functions ******************************************************************/
 
@@ -156,7 +281,8 @@
 //     next frame is due. First call also initializes the terminal. When fps is
 //     zero the function blocks until input is received. Key and mouse events
 //     are immediately followed by a draw event, so the actual fps can be
-//     significantly greater than requested. Always returns true. To reset the
+//     significantly greater than requested. Returns false at the end of a
+//     headless script or replay, otherwise always true. To reset the
 //     terminal after a crash, run "reset".
 //     The Ctrl-C interrupt is masked, so make sure to put an exit condition
 //     like this at the end of the main loop:
@@ -166,17 +292,507 @@
 //
 //     fps     frames per second
 //
+// is_clipped (rect) -> bool
+//
+//     Returns true if rect, in screen coordinates, is not visible in the
+//     current scope. Custom elements can use it to skip drawing early.
+//
 // is_key_press (key) -> bool
 //
 //     Returns true if key was pressed.
 //
 //     key     char literal or one of the KEY constants, see constants
 //
+// post_event (data) -> bool
+//
+//     Queue a user event and wake up the event loop. Safe to call from any
+//     thread. The event is delivered as USER_EVENT with tim.event.data set to
+//     data, followed by a draw event. Returns false when the queue is full.
+//
+//     data    user pointer, passed through as is
+//
+// cached_scope (key, x, y, w, h)
+//
+//     Enter scope like scope (x, y, w, h). On draw events, the block is
+//     skipped and the cells it drew last time are copied instead, as long as
+//     key, placement and screen size are unchanged. Other events always run
+//     the block. Only cells within the scope are saved. The key is a hash of
+//     everything the block displays. Saved cells are looked up by file, line,
+//     key and placement, so a cached scope in a loop keeps the cells of each
+//     item. Up to MAX_MEMO are kept, the least recently used are replaced.
+//
+//     key     uint64 hash of inputs
+//     x/y/w/h see layout documentation
+//
+// canvas (c)
+//
+//     Draw into canvas c within block. Elements and draw functions work as
+//     usual, the canvas is the root scope.
+//
+//         static struct canvas c;           //
+//         canvas_init(&c, 80, 200);         // 80x200 cells
+//         canvas (&c) {                     //
+//             label("Hi", 0, 0, A, A, 0xf); //
+//         }                                 //
+//         blit(&c, 0, top, 0, 0, A, A);     // show rows from top
+//
+// edit_str (state) -> const char*
+//
+//     Current text of edit state, zero terminated. Valid until the next edit
+//     call with this state.
+//
+// edit_free (state)
+//
+//     Free memory of edit state. The next edit call starts over with
+//     state.str.
+//
+// textarea_read (state, pos, buf, size) -> int
+//
+//     Copy up to size bytes of text from byte offset pos to buf. Returns the
+//     number of bytes copied. Text is not zero terminated.
+//
+// textarea_free (state)
+//
+//     Free memory of textarea state. The next textarea call starts over with
+//     state.str.
+//
+// table_changed (state, row)
+//
+//     Mark data row as changed for the next table call, which then only
+//     updates changed rows, see table. Other changes like the count still
+//     update all rows.
+//
+// table_free (state)
+//
+//     Free memory of table state, which stays usable.
+//
+// tree_add (state, parent, text, id, folder) -> int
+//
+//     Add node as last child of parent, -1 adds a root. Text is copied, id is
+//     kept in state.nodes[node].id. Folders can be expanded. Returns the node
+//     or -1 when out of memory. Call from the thread that draws the tree.
+//
+// tree_expand (state, node, expand)
+//
+//     Expand or collapse node, loading its children on first expand.
+//
+// tree_done (state, node)
+//
+//     End background load of node after adding its children.
+//
+// tree_selected (state) -> int
+//
+//     Selected node, -1 for none or a placeholder.
+//
+// tree_free (state)
+//
+//     Free all nodes. Callback and data are kept.
+//
+// chart_push (state, values, n) -> bool
+//
+//     Append n float samples. The oldest samples beyond state.size are
+//     dropped. Returns false when out of memory.
+//
+// chart_free (state)
+//
+//     Free samples of chart state. Size and range are kept.
+//
+// canvas_init (c, w, h) -> bool
+//
+//     Allocate canvas of w * h empty cells. Returns false when out of memory.
+//
+// canvas_free (c)
+//
+//     Free cells of canvas.
+//
+// blit (c, sx, sy, x, y, w, h)
+//
+//     Draw w * h cells of canvas c starting at sx/sy. Automatic width and
+//     height take the rest of the canvas. Cells outside the screen are
+//     clipped.
+//
+//     x/y/w/h see layout documentation
+//
+// canvas_copy (dst, dx, dy, src, sx, sy, w, h)
+//
+//     Copy w * h cells from src at sx/sy to dst at dx/dy. The canvases may be
+//     the same, overlapping areas are handled. Clipped to both canvases.
+//
+// canvas_scroll (c, dx, dy, fill)
+//
+//     Move content of c by dx columns and dy rows. Uncovered cells are set to
+//     fill.
+//
+// tim_open (in, out) -> state
+//
+//     Create context on terminal file descriptors (unix) or console handles
+//     (windows). The terminal is initialized when tim_run is first called with
+//     the context. Returns NULL when out of memory.
+//
+// tim_close (state)
+//
+//     Reset terminal and free context. Descriptors are not closed.
+//
+// tim_use (state) -> state
+//
+//     Make state the current context of the calling thread, returns previous.
+//     The context (state) block does the same and restores the previous one.
+//
 // time_us () -> int64
 //
 //     Returns monotonic clock value in microseconds. Not affected by summer
 //     time or leap seconds.
 
+/* headless *******************************************************************/
+
+// A headless context has no terminal. Its screen size is set on creation,
+// input comes from a script of events and output goes into a small built-in
+// terminal emulator (vt). The emulated screen can then be compared to the
+// frame the renderer meant to present, which makes it possible to test and
+// benchmark elements and renderer without a terminal.
+//
+//     struct event script[] = {
+//         {.type = KEY_EVENT, .key = 'a', .str = "a"},
+//         {.type = DRAW_EVENT, .x = 100, .y = 30}, // resize to 100x30
+//     };
+//     struct state* s = tim_headless(80, 24);
+//     context (s) {
+//         tim_script(script, ARRAY_SIZE(script));
+//         while (tim_run(0)) {                     // false after script
+//             ...
+//             assert(vt_check() == 0);             // last frame is on screen
+//         }
+//     }
+//     tim_close(s);
+//
+// A DRAW_EVENT with non-zero x and y resizes the screen to x columns and y
+// rows. The emulator understands the subset of escape sequences tim writes.
+// Characters are one column wide.
+//
+// tim_headless (w, h) -> state
+//
+//     Create headless context with w columns and h rows. NULL when out of
+//     memory.
+//
+// tim_script (events, n)
+//
+//     Set input events of current headless context. Posted user events are
+//     delivered as well. tim_run returns false when all events are consumed.
+//
+// vt_check () -> int
+//
+//     Number of cells of the emulated screen that differ from the last
+//     rendered frame of the current headless context.
+
+/* recording ******************************************************************/
+
+// Input events, resizes and their timing can be recorded to a file and
+// replayed later, either in real time or as fast as possible. A replay renders
+// the same output as the recorded session as long as the application only
+// depends on its input, which makes real sessions repeatable, for example in a
+// headless context for performance runs.
+//
+//     FILE* f = fopen("session.rec", "wb");  //
+//     tim_record(f);                         // record current context
+//     ...                                    //
+//     struct state* s = tim_headless(80, 24);
+//     context (s) {                          //
+//         tim_replay(f, true);               // replay without delays
+//         while (tim_run(0)) {               // false at end of recording
+//             ...                            //
+//         }                                  //
+//     }                                      //
+//
+// User events are replayed with NULL data. Replay into a terminal context
+// needs a terminal of the recorded size.
+//
+// tim_record (file)
+//
+//     Record events of current context to file, NULL stops recording.
+//
+// tim_replay (file, fast)
+//
+//     Replay recorded events into the current context instead of reading
+//     input. Events are delayed like recorded, unless fast is true.
+
+/* statistics *****************************************************************/
+
+// Every rendered frame updates counters in tim.stats. They are cheap enough to
+// stay enabled and tell whether the application, the encoder or the terminal
+// connection is the bottleneck.
+//
+//     tim.stats.last.encode_us               // last frame
+//     tim.stats.avg.bytes                    // average of last 64 frames
+//     tim.stats.max.ui_us                    // maximum of last 64 frames
+//
+// Averages and maxima cover a window of the last MAX_STATS frames, which
+// moves by one frame per render. Until that many frames were rendered, they
+// cover the frames so far.
+//
+//  counter       | meaning
+// ---------------|------------------------------------------------
+//  cells_diffed  | cells compared with previous frame
+//  cells_emitted | cells written to output
+//  cursor_moves  | cursor position sequences
+//  sgr_changes   | color sequences
+//  bytes         | bytes written
+//  writes        | write calls
+//  events        | events processed
+//  passes        | application passes, usually two per input event
+//  ui_us         | time from reading the event to render
+//  encode_us     | time spent encoding the frame
+//  write_us      | time spent writing the frame
+//
+// Server sessions write without blocking after the frame is rendered, so
+// their bytes and writes are added to the next frame and write_us is zero.
+//
+// Input latency is measured from reading a key or mouse event, or from the
+// first signal of a coalesced resize, to the end of the write that presents
+// the frame drawn in response. Samples go into one histogram per kind with
+// about 6% precision.
+//
+//     latency_percentile(KEY_LATENCY, 99)    // p99 in microseconds
+//
+// latency_percentile (kind, p) -> int64
+//
+//     Latency in microseconds at percentile p (0 to 100) of histogram kind,
+//     which is KEY_LATENCY, MOUSE_LATENCY or RESIZE_LATENCY. Zero when there
+//     are no samples. tim.latency[kind].count holds the number of samples.
+//
+// latency_reset (kind)
+//
+//     Clear histogram kind.
+
+/* tracing ********************************************************************/
+
+// Compiled with TIM_TRACE, the event loop records spans for waiting, event and
+// draw passes, clearing, encoding and writing into a lock-free ring buffer of
+// MAX_TRACE spans. Spans can be dumped as chrome trace json, which opens in
+// chrome://tracing or ui.perfetto.dev. Without TIM_TRACE, tracing compiles to
+// nothing.
+//
+//     trace ("load") {                       // user span around block
+//         load_data();                       //
+//     }                                      //
+//     trace_dump(stdout);                    // write json
+//
+// When the TIM_TRACE_FILE environment variable is set, spans are dumped to
+// that file at exit. Each thread gets its own track. Span names must be
+// static strings without quotes.
+//
+// trace (name)
+//
+//     Record time spent in block, or in the following statement.
+//
+// trace_dump (file)
+//
+//     Write all spans still in the ring buffer as chrome trace json to file.
+
+/* profiling ******************************************************************/
+
+// A profiler attributes time and cells to named scopes and to element kinds
+// (label, button, ...). Named scopes work like scope and count the cells that
+// changed within their area, elements count the cells they drew. Times include
+// nested scopes and elements. The overlay shows the eight heaviest probes of
+// the last frame in place and as a list in the top right corner.
+//
+//     static struct profile prof;            // zero initialized
+//     tim.profile = &prof;                   // profile current context
+//     named_scope ("sidebar", 0, 0, 20, ~0) {
+//         ...                                //
+//     }                                      //
+//     if (is_key_press('p'))                 //
+//         prof.overlay = !prof.overlay;      // toggle overlay
+//
+// Probes are found by name pointer, so names must be static strings. Up to
+// MAX_PROBE probes are kept, the values of the last frame are in
+// prof.probes[i].last_us, last_cells and last_calls. Without a profiler the
+// hooks cost a branch.
+//
+// named_scope (name, x, y, w, h)
+//
+//     Enter scope like scope (x, y, w, h) and profile it under name.
+
+/* server *********************************************************************/
+
+// A server drives many sessions from a single thread. Each session is a
+// context with its own screen size, input, diff state and focus. Sessions are
+// ptys (see openpty) or connections accepted on a unix socket. serve_run works
+// like tim_run, the current context is the session that needs a pass.
+//
+//     struct server srv = {0};
+//     serve_listen(&srv, "/tmp/tim.sock");   // connect with: socat
+//     while (serve_run(&srv, 0)) {           //   UNIX-CONNECT:/tmp/tim.sock
+//         label("Hi", A, A, A, A, 0xf);      //   STDIO,raw,echo=0
+//         if (is_key_press('q')) {           //
+//             serve_drop(&srv);              // end session
+//         }                                  //
+//     }                                      //
+//
+// Output is written without blocking. A session whose previous frame was not
+// fully written skips frames and stops reading input until its output drains.
+// Connections without a tty report their size in reply to a query. Sessions do
+// not receive post_event wake ups. Sockets of clients that went away don't
+// raise SIGPIPE, for pipes added with serve_add the application must ignore
+// SIGPIPE. Unix only.
+//
+// serve_listen (server, path) -> bool
+//
+//     Listen for connections on unix socket path. Returns false on error.
+//
+// serve_add (server, in, out) -> state
+//
+//     Add session on terminal file descriptors, for example a pty. The
+//     descriptors are not closed by the server. Returns NULL on error.
+//
+// serve_run (server, fps) -> bool
+//
+//     Like tim_run for all sessions. Returns false when there is neither a
+//     session nor a listening socket.
+//
+// serve_drop (server)
+//
+//     End current session after the current pass.
+
+/* mirror *********************************************************************/
+
+// A mirror broadcasts the frames of a context read-only to many viewers, for
+// example sockets. Viewers join at any time and may be slow. Each viewer gets
+// the difference from the last frame it fully received to the latest frame.
+// Viewers at the same frame share a single encoding. A viewer that is still
+// busy with an older frame skips all frames in between. Frames older than
+// MAX_HISTORY are repainted in full. Unix only.
+//
+//     static struct mirror m;
+//     tim.mirror = &m;                       // mirror current context
+//     mirror_add(&m, fd);                    // add viewer
+//
+// Viewers are written without blocking whenever a frame is rendered. Use a
+// non-zero fps so that slow viewers catch up while the screen is idle. Viewers
+// are expected to have the same screen size. Sockets that went away don't
+// raise SIGPIPE, for pipes the application must ignore SIGPIPE.
+//
+// mirror_add (mirror, fd) -> bool
+//
+//     Add viewer on output file descriptor, which is closed by the mirror when
+//     the viewer goes away. Returns false when there are too many viewers.
+//
+// mirror_flush (mirror)
+//
+//     Continue writing to viewers without blocking, for example when the
+//     context is idle. Called by every rendered frame.
+
+/* asciicast ******************************************************************/
+
+// Rendered frames can be recorded as asciicast v2 stream, which plays with
+// asciinema. The first recorded frame is painted in full. Formatting and
+// writing happen on a background thread, render only copies the frame output.
+//
+//     FILE* f  = fopen("demo.cast", "w");    //
+//     tim.cast = cast_open(f);               // record current context
+//     ...                                    //
+//     cast_close(tim.cast);                  // write pending frames
+//     tim.cast = NULL;                       //
+//     fclose(f);                             //
+//
+// On unix, link with -pthread when the C library needs it.
+//
+// cast_open (file) -> cast
+//
+//     Start recorder writing to file. Returns NULL on error.
+//
+// cast_close (cast)
+//
+//     Write pending frames and free recorder. The file is not closed.
+
+/* pager **********************************************************************/
+
+// A pager shows a file without reading it. The file is memory mapped and a
+// background thread indexes line starts, scanning for newlines with SSE2 where
+// available. Memory use is one offset per line. The first screen shows as
+// soon as the first chunk is indexed. Index progress and file growth wake the
+// context that opened the pager with a USER_EVENT, tim.event.data is the
+// pager.
+//
+//     struct pager* p = pager_open("big.log"); //
+//     while (tim_run(0)) {                    //
+//         pager(p, 0, 0, ~0, ~0, 0xf);         // show file
+//         ...                                  //
+//     }                                        //
+//     pager_close(p);                          //
+//
+// pager_open (path) -> pager
+//
+//     Map file and start indexing it in the current context. Returns NULL on
+//     error. The file is watched for growth until closed, a truncated file
+//     is indexed again. Close the pager before its context.
+//
+// pager_close (pager)
+//
+//     Stop indexer and unmap file.
+//
+// pager (pager, x, y, w, h, color)
+//
+//     Draw visible lines of file. The wheel scrolls, a click focuses the
+//     pager. When focused, arrow, page and home keys scroll, end turns on
+//     follow mode, escape relinquishes focus. In follow mode, which is
+//     pager.follow, the last lines stay visible while the file grows. The
+//     first visible line is pager.top, the number of lines indexed so far is
+//     pager.total.
+//
+//     pager   pager from pager_open
+//     x/y/w/h see layout documentation
+//     color   background, text
+
+/* filter *********************************************************************/
+
+// A filter is a fuzzy finder over millions of items, typed into an edit. The
+// query matches items that contain its characters in order, ignoring ascii
+// case. Matches score higher for consecutive characters and word starts, and
+// lower for gaps. Worker threads, one per core, score chunks of items and
+// search characters 16 bytes at a time with SSE2 where available. The best
+// MAX_MATCH matches are merged into a virtualized list while the scan runs,
+// so the first matches show before it finishes. When the query extends the
+// previous one, only previous matches are scanned again. Progress wakes the
+// context of the first draw with a USER_EVENT, tim.event.data is the filter.
+//
+//     static struct filter f = {.item = name};  // name (i, data) -> str
+//     static struct edit   e = {0};             //
+//     while (tim_run(0)) {                      //
+//         if (filter(&f, &e, count, 0, 3, ~0, ~0, 0xf)) {
+//             open(filter_selected(&f));        //
+//         }                                     //
+//         edit(&e, 0, 0, ~0, 0xff000f);          // after filter
+//     }                                         //
+//     filter_free(&f);                          //
+//
+// filter (state, query, count, x, y, w, h, color) -> bool
+//
+//     Draw matches of the query edit among count items, or all items for an
+//     empty query. The item callback in state returns the text of item i, is
+//     called from worker threads and must be thread safe. Items may still be
+//     read after the query changed, but not after filter returned with a new
+//     count, so change count before freeing items. Behaves like list.
+//     While the query is focused, up, down, page and return keys go to the
+//     list, so draw the filter before the edit. The number of matches found
+//     so far is state.matches, state.done is set when the scan finished.
+//     Returns true when a match is clicked or return is pressed.
+//
+//     state   pointer to persistent filter state struct
+//     query   pointer to edit state of the query
+//     count   number of items, changing it restarts the scan
+//     x/y/w/h see layout documentation
+//     color   background, text
+//
+// filter_selected (state) -> int
+//
+//     Returns the selected item, -1 when nothing matches.
+//
+// filter_free (state)
+//
+//     Stop worker threads and free matches. Free the filter before its
+//     context.
+
 /* useful links ***************************************************************/
 
 // https://invisible-island.net/xterm/ctlseqs/ctlseqs.html
@@ -192,6 +808,17 @@
 // - Decomposed (NFD) UTF-8 is not supported and will cause havoc
 // - Zero width code points are not supported
 // - Windows cmd.exe resize events may be delayed
+// - Truncating a file while a pager shows it may crash with SIGBUS until the
+//   indexer notices, which takes up to PAGER_POLL milliseconds
+// - The epoll backend blocks SIGWINCH on the first tim_run. Threads created
+//   before that must block it as well, or the signal may go missing.
+
+/* changes ********************************************************************/
+
+// - struct edit no longer holds the text in a fixed char array. The initial
+//   text moved to state.init, which is copied on first use. The current text
+//   is read with edit_str and edit_free releases it. Code that accessed
+//   state.str fails to compile and must be changed accordingly.
 
 /* compatibility **************************************************************/
 
@@ -251,12 +878,28 @@
 // unix-like
 #if defined __unix__ || defined __unix || defined __APPLE__ || defined __ELF__
 #define TIM_UNIX
+#include <errno.h>
+#include <fcntl.h>
 #include <poll.h>
+#include <pthread.h>
 #include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
 #include <termios.h>
 #include <unistd.h>
 #endif
 
+// linux, define TIM_POLL to use the portable poll backend instead of epoll
+#if defined __linux__ && !defined TIM_POLL
+#define TIM_EPOLL
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
+#endif
+
 // windows
 #ifdef _WIN32
 #define TIM_WINDOWS
@@ -265,6 +908,21 @@
 #include <windows.h>
 #endif
 
+// sse2, used to scan for newlines, fuzzy matches and chart ranges
+#if defined __SSE2__ || defined _M_X64 || (defined _M_IX86_FP && _M_IX86_FP >= 2)
+#define TIM_SSE2
+#include <emmintrin.h>
+#endif
+
+// address sanitizer, which rejects aligned reads past the end of a string
+#if defined __SANITIZE_ADDRESS__
+#define TIM_ASAN
+#elif defined __has_feature
+#if __has_feature(address_sanitizer)
+#define TIM_ASAN
+#endif
+#endif
+
 // libc
 #include <limits.h>
 #include <signal.h>
@@ -292,6 +950,17 @@
 #undef MOUSE_EVENT // 0x0002
 #endif
 
+// thread local storage
+#if defined _MSC_VER
+#define TIM_TLS __declspec(thread)
+#elif defined __GNUC__ || defined __clang__
+#define TIM_TLS __thread
+#elif __STDC_VERSION__ >= 201112L
+#define TIM_TLS _Thread_local
+#else
+#define TIM_TLS
+#endif
+
 #ifdef __PCC__
 // Guard to identify dynamic shared objects during global destruction. Not sure
 // if this is a good idea. pcc and tcc may require this.
@@ -304,6 +973,21 @@ int __dso_handle;
 #define MAX_SCOPE   20              // max scope nesting
 #define MAX_CELLS   0x20000         // size of screen buffer
 #define MAX_BUF     (MAX_CELLS * 4) // size of output buffer
+#define MAX_POST    256             // size of user event queue, power of 2
+#define RESIZE_MS   40              // resize events within are coalesced
+#define MAX_SESSION 1024            // max sessions per server
+#define MAX_VIEWER  64              // max viewers per mirror
+#define MAX_HISTORY 8               // frames kept by mirror
+#define MAX_STATS   64              // frames per stats average and maximum
+#define MAX_LATENCY 448             // latency histogram buckets
+#define MAX_TRACE   0x10000         // size of trace ring buffer, power of 2
+#define MAX_PROBE   64              // max named scopes and elements profiled
+#define MAX_CAST    (MAX_BUF * 2)   // asciicast buffer, fits at least a frame
+#define MAX_MEMO    64              // max cached scopes per context
+#define MAX_COLUMN  32              // max table columns
+#define MAX_PAGER   4096            // max bytes of visible part of a line
+#define MAX_QUERY   256             // max bytes of filter query
+#define MAX_MATCH   1000            // best matches kept by filter
 #define A           INT_MAX         // auto center / width / height
 
 // tim.event.type
@@ -312,11 +996,21 @@ enum {
     KEY_EVENT,   // a key was pressed
     MOUSE_EVENT, // mouse button, scroll or move
     VOID_EVENT,  // set when an event was consumed
+    USER_EVENT,  // event posted by post_event
+};
+
+// latency histograms, tim.latency
+enum {
+    KEY_LATENCY,    // key press to screen
+    MOUSE_LATENCY,  // mouse click to screen
+    RESIZE_LATENCY, // first resize signal to screen
 };
 
 // tim.event.key
 enum {
     LEFT_BUTTON   = 1,
+    WHEEL_UP      = 4,
+    WHEEL_DOWN    = 5,
     BACKSPACE_KEY = 8,
     TAB_KEY       = 9,
     ENTER_KEY     = 13,
@@ -333,6 +1027,14 @@ enum {
     RIGHT_KEY     = -10,
 };
 
+// tree_node.state
+enum {
+    TREE_LEAF,     // node has no children
+    TREE_UNLOADED, // children are loaded on first expand
+    TREE_LOADING,  // load is pending, a placeholder row is shown
+    TREE_LOADED,   // children are added
+};
+
 /* types **********************************************************************/
 
 struct cell {
@@ -369,12 +1071,220 @@ struct event {
     int     x;       // used by MOUSE_EVENT
     int     y;       // used by MOUSE_EVENT
     char    str[32]; // string representation of key
+    void*   data;    // used by USER_EVENT
+};
+
+struct post {
+    uint32_t seq;  // sequence number, relative to slot index
+    void*    data; // user data
+};
+
+struct counters {
+    int cells_diffed;  // cells compared with previous frame
+    int cells_emitted; // cells written to output
+    int cursor_moves;  // cursor position sequences
+    int sgr_changes;   // color sequences
+    int bytes;         // bytes written
+    int writes;        // write calls
+    int events;        // events processed
+    int passes;        // application passes
+    int ui_us;         // time spent from event to render
+    int encode_us;     // time spent encoding frame
+    int write_us;      // time spent writing frame
+};
+
+struct stats {
+    struct counters frame;  // frame in progress
+    struct counters last;   // last rendered frame
+    struct counters avg;    // average of last MAX_STATS frames
+    struct counters max;    // maximum of last MAX_STATS frames
+    struct counters sum;    // sum of last MAX_STATS frames
+    struct counters ring[MAX_STATS]; // last frames, oldest is overwritten
+    int             next;   // ring slot of next frame
+    int             frames; // frames in ring
+};
+
+struct latency {
+    int64_t  count;                 // number of samples
+    int64_t  max;                   // largest sample in microseconds
+    uint32_t buckets[MAX_LATENCY];  // log-linear buckets, see latency_bucket
+};
+
+struct span {
+    uint32_t    seq;      // position + 1, zero while being written
+    int         tid;      // thread id
+    const char* name;     // static string
+    int64_t     start_us; // start time
+    int64_t     dur_us;   // duration
+};
+
+struct probe {
+    const char* name;       // static string
+    struct rect rect;       // screen area of named scope, zero for elements
+    int         calls;      // calls in current frame
+    int         us;         // time in current frame
+    int         cells;      // cells in current frame
+    int         last_calls; // calls in last frame
+    int         last_us;    // time in last frame
+    int         last_cells; // changed (scope) or drawn (element) cells
+};
+
+struct profile {
+    struct probe probes[MAX_PROBE]; // named scopes and element kinds
+    int          count;             // number of probes
+    int          open[MAX_SCOPE];   // probe of scope level, -1 for none
+    int64_t      start[MAX_SCOPE];  // enter time of scope level, 0 for none
+    bool         overlay;           // draw heaviest probes over screen
+};
+
+struct canvas {
+    int          w;        // width
+    int          h;        // height
+    struct cell* cells;    // w * h cells
+    struct cell* screen;   // screen buffer while drawing into canvas
+    int          screen_w; // screen width while drawing into canvas
+    int          screen_h; // screen height while drawing into canvas
+};
+
+struct memo {
+    const char*  file;  // call site
+    int          line;  //
+    uint64_t     key;   // hash of inputs
+    struct rect  r;     // scope on screen
+    struct rect  clip;  // visible area of scope
+    int          w;     // screen width
+    int          h;     // screen height
+    struct cell* cells; // saved cells of clip, NULL when invalid
+    int          used;  // frame of last use
 };
 
 struct edit {
-    int  cursor;   // cursor position (utf8)
-    int  length;   // string length (utf8)
-    char str[256]; // zero terminated buffer
+    const char* init;       // initial text, copied on first use
+    int         cursor;     // cursor position (utf8)
+    int         length;     // string length (utf8)
+    char*       buf;        // gap buffer, zero terminated, NULL before use
+    int         size;       // bytes allocated for buf
+    int         bytes;      // bytes of text, excluding gap and terminator
+    int         gap;        // byte offset of gap, gap is zero terminated
+    int         pos;        // byte offset of cursor
+    int         scroll;     // first visible character when focused
+    int         scroll_pos; // byte offset of scroll
+};
+
+struct list {
+    int top;      // first visible row
+    int selected; // selected row
+};
+
+struct column {
+    const char* name;  // header text
+    int         width; // width in columns, A for automatic
+};
+
+struct table {
+    const struct column* columns; // column definitions
+    int                  cols;    // number of columns
+    const char* (*text)(int row, int col, void* data); // text of a cell
+    void*                data;    // user pointer passed to text
+    int                  sort;    // sorted column + 1, negative descending
+    struct list          list;    // scroll and selected position
+    int*                 order;   // permutation, data rows in display order
+    int                  count;   // number of rows in order
+    int                  sorted;  // sort of order
+    uint64_t             key;     // data version of order and widths
+    bool                 valid;   // order and widths are computed
+    uint64_t             color;   // colors of current draw
+    int                  widths[MAX_COLUMN]; // computed column widths
+    int*                 changed;  // rows passed to table_changed
+    int                  nchanged; // number of changed rows
+    int                  changed_cap; // rows allocated for changed
+};
+
+struct piece {
+    int buf;   // 0 for initial text, 1 for added text
+    int start; // byte offset in buffer
+    int size;  // size in bytes
+    int pos;   // byte offset in text
+    int line;  // newlines before piece
+    int lines; // newlines in piece
+};
+
+struct textarea {
+    const char*   str;         // initial text, not copied, must stay valid
+    int           size;        // bytes of str, 0 when zero terminated
+    char*         add;         // added text, appended only
+    int           add_size;    // bytes in add
+    int           add_cap;     // bytes allocated for add
+    int*          nl[2];       // sorted newline offsets of str and add
+    int           nl_count[2]; // number of newline offsets
+    int           nl_cap;      // offsets allocated for nl[1]
+    struct piece* pieces;      // piece table, NULL before first use
+    int           count;       // number of pieces
+    int           cap;         // pieces allocated
+    int           bytes;       // size of text
+    int           cursor;      // byte offset of cursor
+    int           col;         // column kept when moving up and down
+    int           top;         // first visible line
+    int           left;        // first visible column
+};
+
+struct match {
+    int index; // item
+    int score; // higher is better
+};
+
+struct filter {
+    const char* (*item)(int i, void* data); // text of item, called by threads
+    void*         data;      // user pointer passed to item
+    struct list   list;      // scroll and selected position
+    struct match* top;       // best matches in display order
+    int           top_count; // number of best matches
+    int           matches;   // matches found so far
+    bool          done;      // scan of current query finished
+    uint64_t      color;     // colors of current draw
+    struct scan*  scan;      // background matcher, NULL before first use
+};
+
+struct tree_node {
+    char*    text;     // label, copied
+    uint64_t id;       // user key
+    int      parent;   // parent node, -1 for roots
+    int      first;    // first child, -1 for none
+    int      last;     // last child, -1 for none
+    int      next;     // next sibling, -1 for none
+    int      depth;    // number of ancestors
+    int      row;      // row when last shown, may be stale
+    uint8_t  state;    // TREE_LEAF, TREE_UNLOADED, TREE_LOADING, TREE_LOADED
+    bool     expanded; // children are shown
+};
+
+struct tree {
+    bool (*load)(struct tree* t, int node, void* data); // add children
+    void*             data;     // user pointer passed to load
+    struct tree_node* nodes;    // all nodes, NULL before first use
+    int               count;    // number of nodes
+    int               cap;      // nodes allocated
+    int*              rows;     // visible nodes, -2 - node for placeholders
+    int               nrows;    // number of visible rows
+    int               rows_cap; // rows allocated
+    struct list       list;     // scroll and selected row
+    uint64_t          color;    // colors of current draw
+};
+
+struct chart {
+    int     size;  // samples in window, set before first push
+    float*  ring;  // last size samples, NULL before first use
+    int64_t total; // samples pushed
+    float   min;   // fixed value range, automatic when min equals max
+    float   max;   //
+    float   lo;    // value at bottom of last draw
+    float   hi;    // value at top of last draw
+    float*  mins;  // bucket minimums, bucket k in slot k % cols
+    float*  maxs;  // bucket maximums
+    int     cols;  // buckets shown
+    int     per;   // samples per bucket
+    int64_t start; // first sample in buckets
+    int64_t built; // samples merged into buckets
 };
 
 struct state {
@@ -385,18 +1295,66 @@ struct state {
     uintptr_t    focus;             // focused element
     int          loop_stage;        // loop stage
     bool         resized;           // screen was resized
+    int64_t      resize_us;         // pending resize deadline
+    int64_t      resize_max_us;     // latest deadline for pending resize
+    int          frame_w;           // screen width of last frame
+    int          frame_h;           // screen height of last frame
     int          scope;             // current scope
     struct rect  scopes[MAX_SCOPE]; // scope stack
+    struct rect  clips[MAX_SCOPE];  // visible area of scopes
     struct cell* cells;             // screen buffer
+    struct cell* dbuf;              // double buffer, both screen buffers
     char*        buf;               // final output buffer
     int          buf_size;          // position in write buffer
+    int          buf_sent;          // bytes of buf written by server
+    bool         queue_output;      // output is sent by server, no blocking
     int64_t      start_us;          // render start time
     int          render_us;         // elapsed render time
+    struct stats stats;             // render statistics
+    struct latency latency[3];      // input to screen latency histograms
+    int64_t      read_us;           // time input was read
+    int64_t      pending_us;        // read time of input not yet on screen
+    int          pending_kind;      // latency histogram of pending input
+    struct profile* profile;        // scope and element profiler or NULL
+    FILE*        record;            // input recording or NULL
+    FILE*        replay;            // input replay or NULL
+    int64_t      record_us;         // time of last recorded or replayed event
+    bool         replay_fast;       // replay without delays
+    struct cast* cast;              // asciicast recorder or NULL
+    struct memo* memos;             // cached scopes, allocated on first use
+    int          memo_count;        // number of cached scopes
+#ifdef TIM_TRACE                    //
+    int64_t      pass_us;           // start of application pass
+#endif                              //
+    struct post  posts[MAX_POST];   // user event queue
+    uint32_t     post_head;         // next slot to post, shared by threads
+    uint32_t     post_tail;         // next slot to read, event loop only
+    uint32_t     wake_armed;        // event loop waits for wake up
+    bool         poll_size;         // query screen size on every event
+    struct vt*   vt;                // headless terminal emulator
+    const struct event* script;     // headless input events
+    int          script_len;        // number of input events
 #ifdef TIM_UNIX                     //
+    int            fd_in;           // terminal input
+    int            fd_out;          // terminal output
     struct termios attr;            // initial attributes
+    struct mirror* mirror;          // broadcast frames to viewers
+#endif                              //
+#if defined TIM_UNIX && !defined TIM_EPOLL
     int            signal_pipe[2];  // signal fifo pipe
+    int            wake_pipe[2];    // user event wake up pipe
+#endif                              //
+#ifdef TIM_EPOLL                    //
+    int            epoll_fd;        // event loop epoll instance
+    int            signal_fd;       // SIGWINCH signalfd
+    int            timer_fd;        // frame timer
+    int            timer_ms;        // frame timer interval
+    int            wake_fd;         // user event wake up eventfd
 #endif                              //
 #ifdef TIM_WINDOWS                  //
+    HANDLE     in;                  // console input, NULL for stdin
+    HANDLE     out;                 // console output, NULL for stdout
+    HANDLE     wake_event;          // user event wake up event
     SMALL_RECT window;              // screen buffer window size
     DWORD      mode_in;             // initial input mode
     DWORD      mode_out;            // initial output mode
@@ -419,19 +1377,37 @@ struct state {
 static struct cell tim_cells[MAX_CELLS << ENABLE_DBUF]; // screen buffer
 static char        tim_buf[MAX_BUF];                    // output buffer
 
-// global state
+#ifdef TIM_TRACE
+static struct span     tim_trace[MAX_TRACE]; // trace ring buffer
+static uint32_t        tim_trace_head;       // next span position
+static uint32_t        tim_trace_tids;       // number of tracing threads
+static uint32_t        tim_trace_exit;       // dump at exit registered
+static TIM_TLS int     tim_trace_tid;        // thread id of calling thread
+#endif
+
+// default context and current context of calling thread
 #ifdef TIM_EXTERN_STATE
-extern struct state tim;
+extern struct state          tim_state;
+extern TIM_TLS struct state* tim_ctx;
 #else
 // Intentionally not declared as static to trigger a linker error when used in
 // multiple compilation units. If that happens, #define TIM_EXTERN_STATE before
 // including this header in all but one compilation unit.
-struct state tim = {
-    .cells = tim_cells,
-    .buf   = tim_buf,
+struct state tim_state = {
+    .cells  = tim_cells,
+    .dbuf   = tim_cells,
+    .buf    = tim_buf,
+#ifdef TIM_UNIX
+    .fd_in  = STDIN_FILENO,
+    .fd_out = STDOUT_FILENO,
+#endif
 };
+TIM_TLS struct state* tim_ctx = &tim_state;
 #endif
 
+// current context
+#define tim (*tim_ctx)
+
 /* string *********************************************************************/
 
 // like strlen, returns 0 on NULL or int overflow
@@ -543,42 +1519,399 @@ static bool is_wide_perhaps(const uint8_t* s, int n) {
     return true;
 }
 
-/* unix ***********************************************************************/
-
-// Unix-like terminal IO. Osx is missing ppoll and __unix__. Come on, fix it!
+/* atomics ********************************************************************/
 
-#ifdef TIM_UNIX
+// Just enough atomics for the user event queue. Compilers without builtins get
+// plain volatile access, which only works as long as a single thread is used.
 
-static void write_str(const char* s, int size) {
-    ssize_t _ = write(STDOUT_FILENO, s, size);
-    (void)_; // remove unused-result warning
+static inline uint32_t load_u32(volatile uint32_t* p) {
+#if defined __GNUC__ || defined __clang__
+    return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+#elif defined _MSC_VER
+    uint32_t v = *p; // volatile has acquire semantics with /volatile:ms
+    _ReadWriteBarrier();
+    return v;
+#else
+    return *p;
+#endif
 }
 
+static inline void store_u32(volatile uint32_t* p, uint32_t v) {
+#if defined __GNUC__ || defined __clang__
+    __atomic_store_n(p, v, __ATOMIC_RELEASE);
+#elif defined _MSC_VER
+    _ReadWriteBarrier();
+    *p = v;
+#else
+    *p = v;
+#endif
+}
+
+// exchange value, returns previous value
+static inline uint32_t swap_u32(volatile uint32_t* p, uint32_t v) {
+#if defined __GNUC__ || defined __clang__
+    return __atomic_exchange_n(p, v, __ATOMIC_ACQ_REL);
+#elif defined _MSC_VER
+    return InterlockedExchange((volatile LONG*)p, v);
+#else
+    uint32_t old = *p;
+    *p = v;
+    return old;
+#endif
+}
+
+// add to value, returns previous value
+static inline uint32_t add_u32(volatile uint32_t* p, uint32_t v) {
+#if defined __GNUC__ || defined __clang__
+    return __atomic_fetch_add(p, v, __ATOMIC_ACQ_REL);
+#elif defined _MSC_VER
+    return InterlockedExchangeAdd((volatile LONG*)p, v);
+#else
+    uint32_t old = *p;
+    *p += v;
+    return old;
+#endif
+}
+
+// compare and swap, true if *p was old and is now v
+static inline bool cas_u32(volatile uint32_t* p, uint32_t old, uint32_t v) {
+#if defined __GNUC__ || defined __clang__
+    return __atomic_compare_exchange_n(p, &old, v, false, __ATOMIC_ACQ_REL,
+                                       __ATOMIC_RELAXED);
+#elif defined _MSC_VER
+    return InterlockedCompareExchange((volatile LONG*)p, v, old) == (LONG)old;
+#else
+    return *p == old ? (*p = v, true) : false;
+#endif
+}
+
+// full barrier, orders a store before a following load
+static inline void fence(void) {
+#if defined __GNUC__ || defined __clang__
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+#elif defined _MSC_VER
+    MemoryBarrier();
+#endif
+}
+
+// loads before the fence are ordered before loads and stores after it
+static inline void fence_acquire(void) {
+#if defined __GNUC__ || defined __clang__
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+#elif defined _MSC_VER
+    _ReadWriteBarrier();
+#endif
+}
+
+// loads and stores before the fence are ordered before stores after it
+static inline void fence_release(void) {
+#if defined __GNUC__ || defined __clang__
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+#elif defined _MSC_VER
+    _ReadWriteBarrier();
+#endif
+}
+
+/* post queue *****************************************************************/
+
+// Bounded lock-free queue with many producers and a single consumer, the event
+// loop. Each slot carries a sequence number that tells producers and consumer
+// whose turn it is. The number is stored relative to the slot index, so that a
+// zero initialized queue is ready to use.
+
+// push data into queue, false when full
+static bool push_post(void* data) {
+    uint32_t     pos = load_u32(&tim.post_head);
+    struct post* p   = NULL;
+    while (true) {
+        uint32_t i    = pos % MAX_POST;
+        p             = &tim.posts[i];
+        int32_t  diff = (int32_t)(load_u32(&p->seq) + i - pos);
+        if (diff < 0) {
+            // slot of previous round not yet consumed
+            return false;
+        } else if (diff > 0) {
+            // another producer took the slot
+            pos = load_u32(&tim.post_head);
+        } else if (cas_u32(&tim.post_head, pos, pos + 1)) {
+            break;
+        }
+    }
+    p->data = data;
+    store_u32(&p->seq, pos + 1 - pos % MAX_POST); // publish
+    return true;
+}
+
+// pop data from queue into *data, false when empty
+static bool pop_post(void** data) {
+    uint32_t     pos = tim.post_tail;
+    uint32_t     i   = pos % MAX_POST;
+    struct post* p   = &tim.posts[i];
+    if (load_u32(&p->seq) + i != pos + 1) {
+        return false;
+    }
+    *data = p->data;
+    store_u32(&p->seq, pos + MAX_POST - i); // release slot for next round
+    tim.post_tail = pos + 1;
+    return true;
+}
+
+/* emulator *******************************************************************/
+
+// Terminal emulator for headless contexts. Supports cursor position, 256
+// colors, erase display and the alternate buffer, which is all tim writes.
+
+struct vt {
+    int          w;       // screen width
+    int          h;       // screen height
+    int          x;       // cursor column
+    int          y;       // cursor row
+    uint8_t      fg;      // current foreground color
+    uint8_t      bg;      // current background color
+    int          state;   // parser state: 0 text, 1 escape, 2 csi
+    int          len;     // bytes in seq
+    char         seq[32]; // pending escape sequence or utf8 code point
+    int          writes;  // number of writes
+    int64_t      bytes;   // number of bytes written
+    struct cell* cells;   // screen, MAX_CELLS
+};
+
+static void set_screen_size(int w, int h) {
+    tim.resized = (unsigned)(w * h) <= MAX_CELLS && (w != tim.w || h != tim.h);
+    if (tim.resized) {
+        tim.w = tim.scopes[0].w = tim.clips[0].w = w;
+        tim.h = tim.scopes[0].h = tim.clips[0].h = h;
+    }
+}
+
+// clear emulated screen
+static void vt_clear(struct vt* vt) {
+    struct cell c = {.fg = vt->fg, .bg = vt->bg, .n = 1, .buf = " "};
+    for (int i = 0; i < vt->w * vt->h; i++) {
+        vt->cells[i] = c;
+    }
+}
+
+// resize emulated screen, keeps content in top left corner like xterm
+static void vt_resize(struct vt* vt, int w, int h) {
+    struct cell* c  = vt->cells;
+    struct cell  sp = {.n = 1, .buf = " "};
+    struct cell* tmp = malloc(sizeof(*c) * w * h);
+    if (!tmp || (unsigned)(w * h) > MAX_CELLS) {
+        free(tmp);
+        return;
+    }
+    for (int y = 0; y < h; y++) {
+        for (int x = 0; x < w; x++) {
+            bool old = x < vt->w && y < vt->h;
+            tmp[x + y * w] = old ? c[x + y * vt->w] : sp;
+        }
+    }
+    memcpy(c, tmp, sizeof(*c) * w * h);
+    free(tmp);
+    vt->w = w;
+    vt->h = h;
+    vt->x = MIN(vt->x, w - 1);
+    vt->y = MIN(vt->y, h - 1);
+}
+
+// execute complete csi sequence in vt->seq
+static void vt_csi(struct vt* vt) {
+    char  cmd = vt->seq[vt->len - 1];
+    char* s   = vt->seq + 1;
+    int   p[8] = {0};
+    int   n    = 0;
+    if (s[0] == '?') {
+        // private mode, only the alternate buffer matters
+        if (atoi(s + 1) == 1049) {
+            vt_clear(vt);
+        }
+        return;
+    }
+    while (n < (int)ARRAY_SIZE(p) && s < vt->seq + vt->len - 1) {
+        p[n++] = strtol(s, &s, 10);
+        s += (s[0] == ';');
+    }
+    switch (cmd) {
+    case 'H':
+        vt->y = MIN(MAX(p[0], 1), vt->h) - 1;
+        vt->x = MIN(MAX(p[1], 1), vt->w) - 1;
+        break;
+    case 'J':
+        if (p[0] == 2) {
+            vt_clear(vt);
+        }
+        break;
+    case 'm':
+        for (int i = 0; i < MAX(n, 1); i++) {
+            if (p[i] == 0) {
+                vt->fg = vt->bg = 0;
+            } else if ((p[i] == 38 || p[i] == 48) && i + 2 < n &&
+                       p[i + 1] == 5) {
+                *(p[i] == 38 ? &vt->fg : &vt->bg) = p[i + 2];
+                i += 2;
+            }
+        }
+        break;
+    }
+}
+
+// feed output into emulator
+static void vt_write(struct vt* vt, const char* s, int size) {
+    vt->writes += 1;
+    vt->bytes  += size;
+    for (int i = 0; i < size; i++) {
+        uint8_t ch = s[i];
+        if (vt->state == 1) {
+            // escape, only csi is of interest
+            vt->state = (ch == '[') ? 2 : 0;
+            vt->len   = 0;
+            vt->seq[vt->len++] = ch;
+        } else if (vt->state == 2) {
+            // csi, parameters until final byte
+            if (vt->len < (int)sizeof(vt->seq) - 1) {
+                vt->seq[vt->len++] = ch;
+            }
+            if (ch >= 0x40 && ch <= 0x7e) {
+                vt->seq[vt->len] = 0;
+                vt_csi(vt);
+                vt->state = 0;
+                vt->len   = 0;
+            }
+        } else if (ch == 27) {
+            vt->state = 1;
+        } else if (ch == '\r') {
+            vt->x = 0;
+        } else if (ch == '\n') {
+            vt->y = MIN(vt->y + 1, vt->h - 1);
+        } else if (ch >= ' ') {
+            // collect utf8 code point, its length is given by the lead byte
+            vt->len = ((ch & 192) == 128) ? MIN(vt->len, 3) : 0;
+            vt->seq[vt->len++] = ch;
+            if (vt->len >= MAX(bsr8(~(uint8_t)vt->seq[0]), 1)) {
+                struct cell c = {.fg = vt->fg, .bg = vt->bg, .n = vt->len};
+                memcpy(c.buf, vt->seq, vt->len);
+                vt->cells[vt->x + vt->y * vt->w] = c;
+                vt->x   = MIN(vt->x + 1, vt->w - 1); // no auto wrap
+                vt->len = 0;
+            }
+        }
+    }
+}
+
+/* unix ***********************************************************************/
+
+// Unix-like terminal IO. Osx is missing ppoll and __unix__. Come on, fix it!
+//
+// There are two event loop backends. The portable one uses poll with pipes for
+// signals and wake ups. On Linux, epoll is used instead. Signals arrive via a
+// signalfd, the frame timer is a timerfd and wake ups go through an eventfd.
+// Nothing has to be set up per wait, and signals no longer need a handler.
+
+#ifdef TIM_UNIX
+
+static inline int64_t time_us(void) {
+    struct timespec ts = {0};
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void sleep_us(int64_t us) {
+    struct timespec ts = {us / 1000000, (us % 1000000) * 1000};
+    nanosleep(&ts, NULL);
+}
+
+// write to fd, sockets do not raise SIGPIPE when the peer went away
+static ssize_t write_fd(int fd, const void* buf, size_t size) {
+#ifdef MSG_NOSIGNAL
+    ssize_t n = send(fd, buf, size, MSG_NOSIGNAL);
+    if (n >= 0 || errno != ENOTSOCK) {
+        return n;
+    }
+#endif
+    return write(fd, buf, size);
+}
+
+static void write_str(const char* s, int size) {
+    if (tim.vt) {
+        vt_write(tim.vt, s, size);
+        return;
+    }
+    // server sessions may be sockets of clients that went away
+    ssize_t _ = tim.queue_output ? write_fd(tim.fd_out, s, size)
+                                 : write(tim.fd_out, s, size);
+    (void)_; // remove unused-result warning
+}
+
+#ifdef TIM_EPOLL
+
+static void wake_up(void) {
+    uint64_t one = 1;
+    ssize_t  _   = write(tim.wake_fd, &one, sizeof(one));
+    (void)_; // remove unused-result warning
+}
+
+#else
+
 static void signal_handler(int signal) {
-    // signals are written into a fifo pipe and read by event loop
-    ssize_t _ = write(tim.signal_pipe[1], &signal, sizeof(signal));
+    // signals are written into a fifo pipe and read by event loop, they always
+    // belong to the default context
+    ssize_t _ = write(tim_state.signal_pipe[1], &signal, sizeof(signal));
     (void)_; // remove unused-result warning
 }
 
+static void wake_up(void) {
+    // one byte is enough, the event loop drains the whole queue
+    ssize_t _ = write(tim.wake_pipe[1], "", 1);
+    (void)_; // remove unused-result warning
+}
+
+#endif // TIM_EPOLL
+
 static void update_screen_size(void) {
     struct winsize ws = {0};
-    if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) != 0) {
+    if (ioctl(tim.fd_out, TIOCGWINSZ, &ws) != 0) {
         return;
     }
-    int w = ws.ws_col;
-    int h = ws.ws_row;
-    tim.resized = (unsigned)(w * h) <= MAX_CELLS && (w != tim.w || h != tim.h);
-    if (tim.resized) {
-        tim.w = tim.scopes[0].w = w;
-        tim.h = tim.scopes[0].h = h;
+    set_screen_size(ws.ws_col, ws.ws_row);
+}
+
+// Dragging a window edge produces a storm of SIGWINCH. The screen size is only
+// updated after no signal was received for RESIZE_MS, but at least every four
+// times that, so that only the final size is painted.
+static void defer_resize(void) {
+    int64_t now = time_us();
+    if (!tim.resize_us) {
+        tim.resize_max_us = now + RESIZE_MS * 4000;
     }
+    tim.resize_us = MIN(now + RESIZE_MS * 1000, tim.resize_max_us);
+}
+
+// milliseconds until pending resize is due, or -1
+static int resize_timeout(void) {
+    if (!tim.resize_us) {
+        return -1;
+    }
+    int64_t us = tim.resize_us - time_us();
+    return us > 0 ? (int)((us + 999) / 1000) : 0; // round up
+}
+
+// update screen size if pending resize is due, true if so
+static bool apply_resize(void) {
+    if (!tim.resize_us || tim.resize_us > time_us()) {
+        return false;
+    }
+    tim.resize_us = 0;
+    tim.read_us   = tim.resize_max_us - RESIZE_MS * 4000; // first signal
+    update_screen_size();
+    return true;
 }
 
 static void init_terminal(void) {
-    tcgetattr(STDOUT_FILENO, &tim.attr);        // store attributes
+    tcgetattr(tim.fd_out, &tim.attr);           // store attributes
     struct termios attr = tim.attr;             //
     cfmakeraw(&attr);                           // configure raw mode
-    tcsetattr(STDOUT_FILENO, TCSADRAIN, &attr); // set new attributes
+    tcsetattr(tim.fd_out, TCSADRAIN, &attr);    // set new attributes
     write_str(S("\33[?2004l"));                 // reset bracketed paste mode
     write_str(S("\33[?1049h"));                 // use alternate buffer
     write_str(S("\33[?25l"));                   // hide cursor
@@ -586,14 +1919,47 @@ static void init_terminal(void) {
     write_str(S("\33[?1002h"));                 // enable button events
     write_str(S("\33[?1006h"));                 // use mouse sgr protocol
     update_screen_size();                       // get terminal size
-    int err = pipe(tim.signal_pipe);            // create signal pipe
-    if (!err) {                                 //
+}
+
+// create event sources for read_event
+static void init_events(void) {
+    bool main = tim_ctx == &tim_state;          // signals go to default
+#ifdef TIM_EPOLL
+    sigset_t mask;                              //
+    sigemptyset(&mask);                         //
+    sigaddset(&mask, SIGWINCH);                 // terminal size changed
+    int flags = EFD_NONBLOCK | EFD_CLOEXEC;     // same as SFD_ and TFD_ flags
+    tim.signal_fd = -1;                         //
+    if (main) {                                 //
+        sigprocmask(SIG_BLOCK, &mask, NULL);    // deliver via signalfd only
+        tim.signal_fd = signalfd(-1, &mask, flags);
+    }                                           //
+    tim.timer_fd  = timerfd_create(CLOCK_MONOTONIC, flags);
+    tim.wake_fd   = eventfd(0, flags);          //
+    tim.epoll_fd  = epoll_create1(EPOLL_CLOEXEC);
+    int fds[] = {tim.signal_fd, tim.fd_in, tim.wake_fd, tim.timer_fd};
+    for (int i = 0; i < (int)ARRAY_SIZE(fds); i++) {
+        // the index identifies the source, see read_event
+        struct epoll_event ev = {.events = EPOLLIN, .data.u32 = i};
+        epoll_ctl(tim.epoll_fd, EPOLL_CTL_ADD, fds[i], &ev);
+    }
+#else
+    tim.signal_pipe[0] = tim.signal_pipe[1] = -1; // ignored by poll
+    if (main && !pipe(tim.signal_pipe)) {       // create signal pipe
         signal(SIGWINCH, signal_handler);       // terminal size changed
+    }                                           //
+    if (!pipe(tim.wake_pipe)) {                 // create wake up pipe
+        for (int i = 0; i < 2; i++) {           // never block, not inherited
+            int fd = tim.wake_pipe[i];
+            fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+            fcntl(fd, F_SETFD, FD_CLOEXEC);
+        }
     }
+#endif
 }
 
 static void reset_terminal(void) {
-    tcsetattr(STDOUT_FILENO, TCSADRAIN, &tim.attr); // restore attributes
+    tcsetattr(tim.fd_out, TCSADRAIN, &tim.attr);    // restore attributes
     write_str(S("\33[?1000l"));                     // disable mouse
     write_str(S("\33[?1002l"));                     // disable mouse
     write_str(S("\33[m"));                          // reset colors
@@ -622,10 +1988,24 @@ static bool parse_input(struct event* restrict e, int n) {
             // left button pressed
             e->key = LEFT_BUTTON;
             return true;
-        } 
+        }
+        if ((btn == 64 || btn == 65) && s[0] == 'M') {
+            // wheel scrolled
+            e->key = (btn == 64) ? WHEEL_UP : WHEEL_DOWN;
+            return true;
+        }
         return false;
     }
 
+    if (n >= 8 && !memcmp(s, S("\33[8;")) && s[n - 1] == 't') {
+        // window size report, reply to \33[18t
+        int h = strtol(s + 4, &s, 10);
+        int w = strtol(s + 1, &s, 10);
+        e->type = DRAW_EVENT;
+        set_screen_size(w, h);
+        return true;
+    }
+
     static struct {char s[4]; int k;} key_table[] = {
         {"[A" , UP_KEY},       //
         {"[B" , DOWN_KEY},     //
@@ -659,23 +2039,126 @@ static bool parse_input(struct event* restrict e, int n) {
     return false;
 }
 
+#ifdef TIM_EPOLL
+
+// (re)arm periodic frame timer, zero disarms
+static void set_frame_timer(int ms) {
+    if (ms == tim.timer_ms) {
+        return;
+    }
+    tim.timer_ms = ms;
+    struct timespec   t  = {ms / 1000, (ms % 1000) * 1000000};
+    struct itimerspec it = {.it_interval = t, .it_value = t};
+    timerfd_settime(tim.timer_fd, 0, &it, NULL);
+}
+
+static void read_event(int timeout_ms) {
+    struct event* e = &tim.event;
+
+    set_frame_timer(MAX(timeout_ms, 0));
+
+    while (true) {
+        memset(e, 0, sizeof(*e));
+
+        // see poll backend
+        store_u32(&tim.wake_armed, 1);
+        fence(); // arm before checking the queue
+        if (pop_post(&e->data)) {
+            e->type = USER_EVENT;
+            return;
+        }
+
+        // sources in order of registration, see init_terminal
+        struct epoll_event evs[4];
+        bool               ready[4] = {0};
+        int n = epoll_wait(tim.epoll_fd, evs, ARRAY_SIZE(evs),
+                           resize_timeout());
+        for (int i = 0; i < n; i++) {
+            ready[evs[i].data.u32 & 3] = evs[i].events & EPOLLIN;
+        }
+
+        if (apply_resize()) {
+            // screen size changed
+            e->type = DRAW_EVENT;
+            return;
+        }
+
+        if (ready[0]) {
+            // received signal, drain all of them
+            struct signalfd_siginfo si[8];
+            int n = read(tim.signal_fd, si, sizeof(si));
+            if (n > 0) {
+                defer_resize(); // SIGWINCH is the only signal
+            }
+        }
+
+        if (ready[1]) {
+            // received input
+            int n       = read(tim.fd_in, e->str, sizeof(e->str) - 1);
+            tim.read_us = time_us();
+            if (parse_input(e, n)) {
+                return;
+            }
+        }
+
+        if (ready[2]) {
+            // received wake up, queue is checked on next iteration
+            uint64_t count = 0;
+            ssize_t  _     = read(tim.wake_fd, &count, sizeof(count));
+            (void)_; // remove unused-result warning
+        }
+
+        if (ready[3]) {
+            // frame is due, missed expirations are dropped
+            uint64_t count = 0;
+            ssize_t  _     = read(tim.timer_fd, &count, sizeof(count));
+            (void)_; // remove unused-result warning
+            memset(e, 0, sizeof(*e));
+            e->type = DRAW_EVENT;
+            return;
+        }
+    } // while
+}
+
+#else
+
 static void read_event(int timeout_ms) {
     struct event* e = &tim.event;
 
-    struct pollfd pfd[2] = {
+    struct pollfd pfd[3] = {
         {.fd = tim.signal_pipe[0], .events = POLLIN},
-        {.fd = STDIN_FILENO,       .events = POLLIN},
+        {.fd = tim.fd_in,          .events = POLLIN},
+        {.fd = tim.wake_pipe[0],   .events = POLLIN},
     };
 
     while (true) {
         memset(e, 0, sizeof(*e));
 
-        int r = poll(pfd, 2, timeout_ms > 0 ? timeout_ms : -1);
+        // Arm wake up before looking at the queue. A producer that posts after
+        // the queue was found empty will see the armed flag and wake us up.
+        store_u32(&tim.wake_armed, 1);
+        fence(); // arm before checking the queue
+        if (pop_post(&e->data)) {
+            e->type = USER_EVENT;
+            return;
+        }
+
+        int wait = timeout_ms > 0 ? timeout_ms : -1;
+        int rt   = resize_timeout();
+        wait     = (rt >= 0 && (wait < 0 || rt < wait)) ? rt : wait;
+        int r    = poll(pfd, 3, wait);
+
+        if (apply_resize()) {
+            // screen size changed, also when input keeps poll from timing out
+            e->type = DRAW_EVENT;
+            return;
+        }
+
         if (r < 0) {
             // poll error, EINTR or EAGAIN
             continue;
         } else if (r == 0) {
-            // poll timeout
+            // poll timeout, frame is due
             e->type = DRAW_EVENT;
             return;
         }
@@ -686,27 +2169,29 @@ static void read_event(int timeout_ms) {
             int n   = read(tim.signal_pipe[0], &sig, sizeof(sig));
             if (n > 0 && sig == SIGWINCH) {
                 // screen size changed
-                e->type = DRAW_EVENT;
-                update_screen_size();
-                return;
+                defer_resize();
             }
         }
 
         if (pfd[1].revents & POLLIN) {
             // received input
-            int n = read(STDIN_FILENO, e->str, sizeof(e->str) - 1);
+            int n       = read(tim.fd_in, e->str, sizeof(e->str) - 1);
+            tim.read_us = time_us();
             if (parse_input(e, n)) {
                 return;
             }
         }
+
+        if (pfd[2].revents & POLLIN) {
+            // received wake up, queue is checked on next iteration
+            char buf[64];
+            ssize_t _ = read(tim.wake_pipe[0], buf, sizeof(buf));
+            (void)_; // remove unused-result warning
+        }
     } // while
 }
 
-static inline int64_t time_us(void) {
-    struct timespec ts = {0};
-    clock_gettime(CLOCK_MONOTONIC, &ts);
-    return ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
-}
+#endif // TIM_EPOLL
 
 #endif // TIM_UNIX
 
@@ -717,14 +2202,34 @@ static inline int64_t time_us(void) {
 
 #ifdef TIM_WINDOWS
 
+static inline int64_t time_us(void) {
+    LARGE_INTEGER ticks = {0};
+    LARGE_INTEGER freq  = {0};
+    QueryPerformanceCounter(&ticks);
+    QueryPerformanceFrequency(&freq);
+    return 1000000 * ticks.QuadPart / freq.QuadPart;
+}
+
+static void sleep_us(int64_t us) {
+    Sleep((DWORD)(us / 1000));
+}
+
 static void write_str(const char* s, int size) {
-    HANDLE h = GetStdHandle(STD_OUTPUT_HANDLE);
+    if (tim.vt) {
+        vt_write(tim.vt, s, size);
+        return;
+    }
+    HANDLE h = tim.out;
     WriteFile(h, s, size, NULL, NULL);
     FlushFileBuffers(h);
 }
 
+static void wake_up(void) {
+    SetEvent(tim.wake_event);
+}
+
 static void update_screen_size(void) {
-    HANDLE hout = GetStdHandle(STD_OUTPUT_HANDLE);
+    HANDLE hout = tim.out;
     CONSOLE_SCREEN_BUFFER_INFO csbi = {0};
     if (GetConsoleScreenBufferInfo(hout, &csbi) == 0) {
         return;
@@ -733,15 +2238,17 @@ static void update_screen_size(void) {
     int h = csbi.srWindow.Bottom - csbi.srWindow.Top + 1;
     tim.resized = (unsigned)(w * h) <= MAX_CELLS && (w != tim.w || h != tim.h);
     if (tim.resized) {
-        tim.w      = tim.scopes[0].w = w;
-        tim.h      = tim.scopes[0].h = h;
+        tim.w      = tim.scopes[0].w = tim.clips[0].w = w;
+        tim.h      = tim.scopes[0].h = tim.clips[0].h = h;
         tim.window = csbi.srWindow;
     }
 }
 
 static void init_terminal(void) {
     DWORD  mode = 0;
-    HANDLE hin  = GetStdHandle(STD_INPUT_HANDLE);
+    tim.in  = tim.in  ? tim.in  : GetStdHandle(STD_INPUT_HANDLE);
+    tim.out = tim.out ? tim.out : GetStdHandle(STD_OUTPUT_HANDLE);
+    HANDLE hin  = tim.in;
     GetConsoleMode(hin, &tim.mode_in);             // get current input mode
     mode = tim.mode_in;                            //
     mode &= ~ENABLE_ECHO_INPUT;                    // disable echo
@@ -753,7 +2260,7 @@ static void init_terminal(void) {
     mode &= ~ENABLE_QUICK_EDIT_MODE;               // disable select mode
     SetConsoleMode(hin, mode);                     // set input mode
                                                    //
-    HANDLE hout = GetStdHandle(STD_OUTPUT_HANDLE); //
+    HANDLE hout = tim.out;                         //
     GetConsoleMode(hout, &tim.mode_out);           // get current output mode
     mode = tim.mode_out;                           //
     mode |= ENABLE_PROCESSED_OUTPUT;               // enable ascii sequences
@@ -768,12 +2275,17 @@ static void init_terminal(void) {
     update_screen_size();                          //
 }
 
+// create event sources for read_event
+static void init_events(void) {
+    tim.wake_event = CreateEvent(NULL, 0, 0, NULL); // user event wake up
+}
+
 static void reset_terminal(void) {
     write_str(S("\33[m"));                         // reset colors
     write_str(S("\33[?25h"));                      // show cursor
     write_str(S("\33[?1049l"));                    // exit alternate buffer
-    HANDLE hin  = GetStdHandle(STD_INPUT_HANDLE);  //
-    HANDLE hout = GetStdHandle(STD_OUTPUT_HANDLE); //
+    HANDLE hin  = tim.in;                          //
+    HANDLE hout = tim.out;                         //
     SetConsoleMode(hin, tim.mode_in);              // set original mode
     SetConsoleMode(hout, tim.mode_out);            //
     SetConsoleCP(tim.cp_in);                       // set original code page
@@ -781,8 +2293,9 @@ static void reset_terminal(void) {
 }
 
 static void read_event(int timeout_ms) {
-    struct event* e = &tim.event;
-    HANDLE        h = GetStdHandle(STD_INPUT_HANDLE);
+    struct event* e    = &tim.event;
+    HANDLE        h    = tim.in;
+    HANDLE        hs[] = {h, tim.wake_event};
 
     static const int8_t key_table[256] = {
         [VK_BACK]   = BACKSPACE_KEY,
@@ -806,12 +2319,21 @@ static void read_event(int timeout_ms) {
         // In cmd.exe the cursor somtimes reappears. This reliably hides it.
         write_str(S("\33[?25l"));
 
-        DWORD r = WaitForSingleObject(h, timeout_ms);
+        // see unix read_event
+        store_u32(&tim.wake_armed, 1);
+        fence(); // arm before checking the queue
+        if (pop_post(&e->data)) {
+            e->type = USER_EVENT;
+            return;
+        }
+
+        DWORD r = WaitForMultipleObjects(2, hs, FALSE, timeout_ms);
         if (r == WAIT_TIMEOUT) {
             e->type = DRAW_EVENT;
             update_screen_size(); // workaround, see WINDOW_BUFFER_SIZE_EVENT
             return;
         } else if (r != WAIT_OBJECT_0) {
+            // wake up or error, queue is checked on next iteration
             continue;
         }
 
@@ -819,6 +2341,7 @@ static void read_event(int timeout_ms) {
         INPUT_RECORD rec = {0};
         DWORD        n   = 0;
         ReadConsoleInput(h, &rec, 1, &n);
+        tim.read_us = time_us();
 
         switch (rec.EventType) {
         case KEY_EVENT: {
@@ -845,16 +2368,20 @@ static void read_event(int timeout_ms) {
         }
 
         case MOUSE_EVENT: {
-            bool move = rec.Event.MouseEvent.dwEventFlags & ~DOUBLE_CLICK;
-            bool left = rec.Event.MouseEvent.dwButtonState &
-                        FROM_LEFT_1ST_BUTTON_PRESSED;
-            if (move || !left) {
+            DWORD flags = rec.Event.MouseEvent.dwEventFlags;
+            DWORD state = rec.Event.MouseEvent.dwButtonState;
+            bool  wheel = flags == MOUSE_WHEELED;
+            bool  move  = flags & ~DOUBLE_CLICK;
+            bool  left  = state & FROM_LEFT_1ST_BUTTON_PRESSED;
+            if (!wheel && (move || !left)) {
                   // ignore move events and buttons other than left
                   continue;
             }
             update_screen_size(); // workaround, see WINDOW_BUFFER_SIZE_EVENT
             e->type = MOUSE_EVENT;
-            e->key  = LEFT_BUTTON;
+            e->key  = !wheel                   ? LEFT_BUTTON
+                      : (SHORT)HIWORD(state) > 0 ? WHEEL_UP
+                                                 : WHEEL_DOWN;
             e->x    = rec.Event.MouseEvent.dwMousePosition.X - tim.window.Left;
             e->y    = rec.Event.MouseEvent.dwMousePosition.Y - tim.window.Top;
             return;
@@ -872,47 +2399,439 @@ static void read_event(int timeout_ms) {
     } // while
 }
 
-static inline int64_t time_us(void) {
-    LARGE_INTEGER ticks = {0};
-    LARGE_INTEGER freq  = {0};
-    QueryPerformanceCounter(&ticks);
-    QueryPerformanceFrequency(&freq);
-    return 1000000 * ticks.QuadPart / freq.QuadPart;
-}
-
 #endif // TIM_WINDOWS
 
-/* events *********************************************************************/
+/* tracing ********************************************************************/
+
+// Spans go into a ring buffer shared by all threads and contexts. Writers
+// claim a position with an atomic add and publish the span with its sequence
+// number, so the dump can skip spans that are overwritten meanwhile. Without
+// TIM_TRACE the macros expand to nothing.
+
+#ifdef TIM_TRACE
+
+#define trace(name) \
+    for (int64_t _t = time_us(); _t; trace_span((name), _t), _t = 0)
+
+// write recorded spans as chrome trace json
+static inline void trace_dump(FILE* f) {
+    uint32_t head  = load_u32(&tim_trace_head);
+    uint32_t first = head > MAX_TRACE ? head - MAX_TRACE : 0;
+    bool     comma = false;
+    fputs("{\"traceEvents\": [\n", f);
+    for (uint32_t pos = first; pos != head; pos++) {
+        struct span* sp  = &tim_trace[pos % MAX_TRACE];
+        uint32_t     seq = load_u32(&sp->seq);
+        struct span  c   = *sp;
+        fence_acquire(); // copy before checking seq again
+        if (seq != pos + 1 || load_u32(&sp->seq) != seq) {
+            continue; // being written or overwritten
+        }
+        fprintf(f,
+                "%s{\"name\": \"%s\", \"ph\": \"X\", \"pid\": 1, "
+                "\"tid\": %d, \"ts\": %lld, \"dur\": %lld}",
+                comma ? ",\n" : "", c.name, c.tid, (long long)c.start_us,
+                (long long)c.dur_us);
+        comma = true;
+    }
+    fputs("\n]}\n", f);
+}
 
-// returns true if event was of type and key
-static inline bool is_event_key(int type, int32_t key) {
-    return tim.event.type == type && tim.event.key == key;
+// dump to file named by TIM_TRACE_FILE environment variable, used with atexit
+static void trace_exit(void) {
+    const char* path = getenv("TIM_TRACE_FILE");
+    FILE*       f    = path ? fopen(path, "w") : NULL;
+    if (f) {
+        trace_dump(f);
+        fclose(f);
+    }
 }
 
-// returns true if event was press of key
-static inline bool is_key_press(int32_t key) {
-    return is_event_key(KEY_EVENT, key);
+// register dump at exit once per process
+static void trace_init(void) {
+    if (cas_u32(&tim_trace_exit, 0, 1)) {
+        atexit(trace_exit);
+    }
 }
 
-// returns true if mouse event was over r
-static inline bool is_mouse_over(struct rect r) {
-    int x = tim.event.x;
-    int y = tim.event.y;
-    return x >= r.x && x < r.x + r.w && y >= r.y && y < r.y + r.h;
+// record span that started at start_us and ends now
+static void trace_span(const char* name, int64_t start_us) {
+    int64_t end = time_us();
+    if (!tim_trace_tid) {
+        tim_trace_tid = add_u32(&tim_trace_tids, 1) + 1;
+        trace_init();
+    }
+    uint32_t     pos = add_u32(&tim_trace_head, 1);
+    struct span* sp  = &tim_trace[pos % MAX_TRACE];
+    swap_u32(&sp->seq, 0); // invalid while written
+    fence_release();       // before the span changes
+    sp->tid      = tim_trace_tid;
+    sp->name     = name;
+    sp->start_us = start_us;
+    sp->dur_us   = end - start_us;
+    store_u32(&sp->seq, pos + 1);
 }
 
-// returns true if event is mouse left-down and over r
-static inline bool is_click_over(struct rect r) {
-    return is_event_key(MOUSE_EVENT, LEFT_BUTTON) && is_mouse_over(r);
+// end application pass that started with last true return of next_pass
+static void trace_pass_end(void) {
+    if (tim.pass_us) {
+        trace_span(tim.loop_stage == 2 ? "event pass" : "draw pass",
+                   tim.pass_us);
+        tim.pass_us = 0;
+    }
 }
 
-/* drawing ********************************************************************/
+#define trace_pass_begin() (tim.pass_us = time_us())
 
-// create cell from utf8 code point with fg and bg colors
-static inline struct cell cell(const char* s, uint8_t fg, uint8_t bg) {
-    struct cell c = {.fg = fg, .bg  = bg, .n = 1, .buf = {s[0]}};
-    while ((s[c.n] & 192) == 128 && c.n < sizeof(c.buf)) {
-        c.buf[c.n] = s[c.n];
+#else
+
+#define trace(name)
+#define trace_pass_end()
+#define trace_pass_begin()
+
+#endif // TIM_TRACE
+
+/* context ********************************************************************/
+
+// enter context block, makes s the current context
+#define context(s) \
+    for (struct state* _p = tim_use(s), *_c = _p; _c; _c = tim_use(_p), _c = 0)
+
+// make s current context of calling thread, returns previous one
+static inline struct state* tim_use(struct state* s) {
+    struct state* prev = tim_ctx;
+    tim_ctx = s ? s : &tim_state;
+    return prev;
+}
+
+// reset default context, used with atexit
+static void reset_default(void) {
+    struct state* prev = tim_use(&tim_state);
+    reset_terminal();
+    tim_use(prev);
+}
+
+// create context on terminal io, NULL when out of memory
+#ifdef TIM_UNIX
+static inline struct state* tim_open(int in, int out) {
+#endif
+#ifdef TIM_WINDOWS
+static inline struct state* tim_open(HANDLE in, HANDLE out) {
+#endif
+    struct state* s = calloc(1, sizeof(*s));
+    if (s) {
+        s->dbuf  = calloc(MAX_CELLS << ENABLE_DBUF, sizeof(*s->dbuf));
+        s->buf   = malloc(MAX_BUF);
+        s->cells = s->dbuf;
+    }
+    if (!s || !s->dbuf || !s->buf) {
+        if (s) {
+            free(s->dbuf);
+            free(s->buf);
+        }
+        free(s);
+        return NULL;
+    }
+#ifdef TIM_UNIX
+    s->fd_in  = in;
+    s->fd_out = out;
+#endif
+#ifdef TIM_EPOLL
+    s->epoll_fd = s->timer_fd = s->wake_fd = -1; // see init_events
+#elif defined TIM_UNIX
+    s->wake_pipe[0] = s->wake_pipe[1] = -1;
+#endif
+#ifdef TIM_WINDOWS
+    s->in  = in;
+    s->out = out;
+#endif
+    s->poll_size = true; // no resize signals
+    return s;
+}
+
+// reset terminal and free context created by tim_open
+static inline void tim_close(struct state* s) {
+    if (!s || s == &tim_state) {
+        return;
+    }
+    context (s) {
+        if (tim.loop_stage) {
+            reset_terminal();
+        }
+#ifdef TIM_EPOLL
+        int fds[] = {tim.epoll_fd, tim.timer_fd, tim.wake_fd};
+#elif defined TIM_UNIX
+        int fds[] = {tim.wake_pipe[0], tim.wake_pipe[1]};
+#endif
+#ifdef TIM_UNIX
+        for (int i = 0; i < (int)ARRAY_SIZE(fds); i++) {
+            if (fds[i] >= 0) {
+                close(fds[i]);
+            }
+        }
+#endif
+#ifdef TIM_WINDOWS
+        if (tim.wake_event) {
+            CloseHandle(tim.wake_event);
+        }
+#endif
+    }
+    if (s->vt) {
+        free(s->vt->cells);
+        free(s->vt);
+    }
+    for (int i = 0; i < s->memo_count; i++) {
+        free(s->memos[i].cells);
+    }
+    free(s->memos);
+    free(s->dbuf);
+    free(s->buf);
+    free(s);
+}
+
+// create headless context with emulated screen, NULL when out of memory
+static inline struct state* tim_headless(int w, int h) {
+#ifdef TIM_UNIX
+    struct state* s = tim_open(-1, -1);
+#endif
+#ifdef TIM_WINDOWS
+    struct state* s = tim_open(NULL, NULL);
+#endif
+    struct vt* vt = s ? calloc(1, sizeof(*vt)) : NULL;
+    if (vt) {
+        vt->cells = calloc(MAX_CELLS, sizeof(*vt->cells));
+    }
+    if (!vt || !vt->cells) {
+        free(vt);
+        tim_close(s);
+        return NULL;
+    }
+    s->vt        = vt;
+    s->poll_size = false;
+    context (s) {
+        set_screen_size(w, h);
+        vt_resize(vt, tim.w, tim.h);
+        tim.loop_stage = 1; // nothing to initialize
+    }
+    return s;
+}
+
+// set input events of headless context
+static inline void tim_script(const struct event* events, int n) {
+    tim.script     = events;
+    tim.script_len = n;
+}
+
+// read next scripted event, false when there is none
+static bool read_script(void) {
+    struct event* e = &tim.event;
+    memset(e, 0, sizeof(*e));
+    if (pop_post(&e->data)) {
+        e->type = USER_EVENT;
+        return true;
+    }
+    if (tim.script_len <= 0) {
+        return false;
+    }
+    *e              = *tim.script;
+    tim.read_us     = time_us();
+    tim.script     += 1;
+    tim.script_len -= 1;
+    if (e->type == DRAW_EVENT && e->x > 0 && e->y > 0) {
+        // resize
+        set_screen_size(e->x, e->y);
+        vt_resize(tim.vt, tim.w, tim.h);
+    }
+    return true;
+}
+
+/* recording ******************************************************************/
+
+// Events are recorded after they were read and parsed, together with the time
+// since the previous event and the screen size when it changed. All numbers
+// are little endian. Replay feeds the same events and sizes into the loop, so
+// the application renders the same frames. The event of the first frame is
+// not read but recorded anyway, replay starts with it.
+//
+//  field | bytes | content
+// -------|-------|------------------------------------------
+//  dt    | 4     | microseconds since previous event, unsigned
+//  type  | 1     | event type, bit 7 set when size follows, bit 6 first frame
+//  size  | 4     | width and height, 2 bytes each
+//  key   | 4     | key and mouse events
+//  x/y   | 4     | mouse events, 2 bytes each
+//  n     | 1     | key events, length of str
+//  str   | n     | key events, raw input
+
+// write n bytes of v as little endian
+static void record_int(FILE* f, int64_t v, int n) {
+    for (int i = 0; i < n; i++) {
+        fputc((int)(v >> (i * 8)) & 255, f);
+    }
+}
+
+// read n byte little endian number, false on end of file
+static bool replay_int(FILE* f, int32_t* v, int n) {
+    uint32_t u = 0;
+    for (int i = 0; i < n; i++) {
+        int c = fgetc(f);
+        if (c == EOF) {
+            return false;
+        }
+        u |= (uint32_t)c << (i * 8);
+    }
+    *v = (int32_t)u;
+    return true;
+}
+
+// record current event, called before its first pass
+static void record_event(void) {
+    FILE*         f   = tim.record;
+    struct event* e   = &tim.event;
+    int64_t       now = time_us();
+    int64_t       dt  = tim.record_us ? now - tim.record_us : 0;
+    tim.record_us     = now;
+    record_int(f, MIN(dt, UINT32_MAX), 4);
+    record_int(f, e->type | (tim.resized ? 128 : 0) | (tim.frame ? 0 : 64), 1);
+    if (tim.resized) {
+        record_int(f, tim.w, 2);
+        record_int(f, tim.h, 2);
+    }
+    if (e->type == KEY_EVENT || e->type == MOUSE_EVENT) {
+        record_int(f, e->key, 4);
+    }
+    if (e->type == MOUSE_EVENT) {
+        record_int(f, e->x, 2);
+        record_int(f, e->y, 2);
+    }
+    if (e->type == KEY_EVENT) {
+        int n = ztrlen(e->str);
+        record_int(f, n, 1);
+        fwrite(e->str, 1, n, f);
+    }
+}
+
+// read next recorded event, false at end of recording
+static bool read_replay(void) {
+    FILE*         f = tim.replay;
+    struct event* e = &tim.event;
+    int32_t       dt, type, w, h, n;
+    memset(e, 0, sizeof(*e));
+    if (!replay_int(f, &dt, 4) || !replay_int(f, &type, 1)) {
+        return false;
+    }
+    e->type = type & 63;
+    if (type & 128) {
+        if (!replay_int(f, &w, 2) || !replay_int(f, &h, 2)) {
+            return false;
+        }
+        set_screen_size(w, h);
+        if (tim.vt) {
+            vt_resize(tim.vt, tim.w, tim.h);
+        }
+    }
+    if (e->type == KEY_EVENT || e->type == MOUSE_EVENT) {
+        replay_int(f, &e->key, 4);
+    }
+    if (e->type == MOUSE_EVENT) {
+        replay_int(f, &e->x, 2);
+        replay_int(f, &e->y, 2);
+    }
+    if (e->type == KEY_EVENT && replay_int(f, &n, 1)) {
+        n = MIN(n, (int)sizeof(e->str) - 1);
+        n = (int)fread(e->str, 1, n, f);
+    }
+    if (!tim.replay_fast) {
+        // wait until event is due, relative to the previous one. dt is
+        // unsigned, past INT32_MAX it would turn negative as int32_t.
+        int64_t wait  = (uint32_t)dt;
+        tim.record_us = tim.record_us ? tim.record_us + wait : time_us();
+        int64_t us    = tim.record_us - time_us();
+        if (us > 0) {
+            sleep_us(us);
+        }
+    }
+    return !feof(f);
+}
+
+// record events of current context to f, NULL stops recording
+static inline void tim_record(FILE* f) {
+    tim.record    = f;
+    tim.record_us = 0;
+}
+
+// replay events from f into current context, fast replays without delays
+static inline void tim_replay(FILE* f, bool fast) {
+    tim.replay      = f;
+    tim.replay_fast = fast;
+    tim.record_us   = 0;
+    if (tim.frame == 0) {
+        read_replay(); // event of first frame
+    }
+}
+
+/* events *********************************************************************/
+
+// post user event, safe to call from any thread, false when queue is full
+static inline bool post_event(void* data) {
+    if (!push_post(data)) {
+        return false;
+    }
+    fence(); // publish before checking whether the loop is armed
+    if (swap_u32(&tim.wake_armed, 0)) {
+        // event loop may be blocked, wake it up
+        wake_up();
+    }
+    return true;
+}
+
+// returns true if event was of type and key
+static inline bool is_event_key(int type, int32_t key) {
+    return tim.event.type == type && tim.event.key == key;
+}
+
+// returns true if event was press of key
+static inline bool is_key_press(int32_t key) {
+    return is_event_key(KEY_EVENT, key);
+}
+
+// intersection of a and b, empty rects have zero width and height
+static inline struct rect clip_rect(struct rect a, struct rect b) {
+    int x0 = MAX(a.x, b.x);
+    int y0 = MAX(a.y, b.y);
+    int x1 = MIN(a.x + a.w, b.x + b.w);
+    int y1 = MIN(a.y + a.h, b.y + b.h);
+    if (x1 <= x0 || y1 <= y0) {
+        return (struct rect){x0, y0, 0, 0};
+    }
+    return (struct rect){x0, y0, x1 - x0, y1 - y0};
+}
+
+// returns true if r is not visible in current scope
+static inline bool is_clipped(struct rect r) {
+    return clip_rect(r, tim.clips[tim.scope]).w == 0;
+}
+
+// returns true if mouse event was over visible part of r
+static inline bool is_mouse_over(struct rect r) {
+    struct rect c = clip_rect(r, tim.clips[tim.scope]);
+    int         x = tim.event.x;
+    int         y = tim.event.y;
+    return x >= c.x && x < c.x + c.w && y >= c.y && y < c.y + c.h;
+}
+
+// returns true if event is mouse left-down and over r
+static inline bool is_click_over(struct rect r) {
+    return is_event_key(MOUSE_EVENT, LEFT_BUTTON) && is_mouse_over(r);
+}
+
+/* drawing ********************************************************************/
+
+// create cell from utf8 code point with fg and bg colors
+static inline struct cell cell(const char* s, uint8_t fg, uint8_t bg) {
+    struct cell c = {.fg = fg, .bg  = bg, .n = 1, .buf = {s[0]}};
+    while ((s[c.n] & 192) == 128 && c.n < sizeof(c.buf)) {
+        c.buf[c.n] = s[c.n];
         c.n += 1;
     }
     return c;
@@ -924,17 +2843,21 @@ static void clear_cells(void) {
     memset(tim.cells, 0, size);
 }
 
+// All draw functions are clipped to the visible area of the current scope.
+
 // draw cell at position
 static void draw_chr(struct cell cell, int x, int y) {
-    if (x >= 0 && x < tim.w && y >= 0 && y < tim.h) {
+    struct rect c = tim.clips[tim.scope];
+    if (x >= c.x && x < c.x + c.w && y >= c.y && y < c.y + c.h) {
         tim.cells[x + y * tim.w] = cell;
     }
 }
 
 // draw row of cells
 static void draw_row(struct cell cell, int x, int y, int w) {
-    if (y >= 0 && y < tim.h && w > 0) {
-        for (int i = MAX(x, 0); i < MIN(x + w, tim.w); i++) {
+    struct rect c = tim.clips[tim.scope];
+    if (y >= c.y && y < c.y + c.h && w > 0) {
+        for (int i = MAX(x, c.x); i < MIN(x + w, c.x + c.w); i++) {
             tim.cells[i + y * tim.w] = cell;
         }
     }
@@ -942,8 +2865,9 @@ static void draw_row(struct cell cell, int x, int y, int w) {
 
 // draw column of cells
 static void draw_col(struct cell cell, int x, int y, int h) {
-    if (x >= 0 && x < tim.w && h > 0) {
-        for (int i = MAX(y, 0); i < MIN(y + h, tim.h); i++) {
+    struct rect c = tim.clips[tim.scope];
+    if (x >= c.x && x < c.x + c.w && h > 0) {
+        for (int i = MAX(y, c.y); i < MIN(y + h, c.y + c.h); i++) {
             tim.cells[x + i * tim.w] = cell;
         }
     }
@@ -951,9 +2875,10 @@ static void draw_col(struct cell cell, int x, int y, int h) {
 
 // fill lot (area) of cells
 static void draw_lot(struct cell cell, int x, int y, int w, int h) {
+    struct rect c = tim.clips[tim.scope];
     if (w > 0 && h > 0) {
-        for (int iy = MAX(y, 0); iy < MIN(y + h, tim.h); iy++) {
-            for (int ix = MAX(x, 0); ix < MIN(x + w, tim.w); ix++) {
+        for (int iy = MAX(y, c.y); iy < MIN(y + h, c.y + c.h); iy++) {
+            for (int ix = MAX(x, c.x); ix < MIN(x + w, c.x + c.w); ix++) {
                 tim.cells[ix + iy * tim.w] = cell;
             }
         }
@@ -963,13 +2888,14 @@ static void draw_lot(struct cell cell, int x, int y, int w, int h) {
 // draw string to line, tags potential wide characters
 static void draw_str(const char* s, int x, int y, int w,
                      uint8_t fg, uint8_t bg) {
-    if (s && y >= 0 && x < tim.w && y < tim.h ) {
-        int  end  = MIN(x + w, tim.w);
+    struct rect cl = tim.clips[tim.scope];
+    if (s && y >= cl.y && x < cl.x + cl.w && y < cl.y + cl.h) {
+        int  end  = MIN(x + w, cl.x + cl.w);
         bool wide = false;
         for (int i = 0; s[i] && x < end; x++) {
             struct cell c = cell(&s[i], fg, bg);
             wide = wide || is_wide_perhaps(c.buf, c.n);
-            if (x >= 0) {
+            if (x >= cl.x) {
                 c.wide = wide;
                 tim.cells[x + y * tim.w] = c;
             }
@@ -993,8 +2919,9 @@ static void draw_box(int x, int y, int w, int h, uint8_t fg, uint8_t bg) {
 
 // invert fg and bg colors of line of cells
 static void draw_invert(int x, int y, int w) {
-    if (y >= 0 && y < tim.h && w > 0) {
-        for (int i = MAX(x, 0); i < MIN(x + w, tim.w); i++) {
+    struct rect c = tim.clips[tim.scope];
+    if (y >= c.y && y < c.y + c.h && w > 0) {
+        for (int i = MAX(x, c.x); i < MIN(x + w, c.x + c.w); i++) {
             struct cell c = tim.cells[i + y * tim.w];
             tim.cells[i + y * tim.w].fg = c.bg;
             tim.cells[i + y * tim.w].bg = c.fg;
@@ -1002,6 +2929,139 @@ static void draw_invert(int x, int y, int w) {
     }
 }
 
+/* profiling ******************************************************************/
+
+// Named scopes and elements report their time and cells to the profiler of the
+// current context. Scopes count the cells that changed since the last frame
+// within their area, elements the cells they drew. Time includes nested scopes
+// and elements.
+
+// probe with name, NULL when there are too many
+static struct probe* find_probe(struct profile* p, const char* name) {
+    for (int i = 0; i < p->count; i++) {
+        if (p->probes[i].name == name) {
+            return &p->probes[i];
+        }
+    }
+    if (p->count == MAX_PROBE) {
+        return NULL;
+    }
+    p->probes[p->count] = (struct probe){.name = name};
+    return &p->probes[p->count++];
+}
+
+// cells of r on screen
+static int screen_cells(struct rect r) {
+    int w = MIN(r.x + r.w, tim.w) - MAX(r.x, 0);
+    int h = MIN(r.y + r.h, tim.h) - MAX(r.y, 0);
+    return (w > 0 && h > 0) ? w * h : 0;
+}
+
+// cells of r that differ from last frame, all of them after a resize
+static int changed_cells(struct rect r) {
+#if ENABLE_DBUF
+    if (tim.frame_w == tim.w && tim.frame_h == tim.h) {
+        const struct cell* old = tim.dbuf + ((tim.frame - 1) & 1) * MAX_CELLS;
+        int                n   = 0;
+        for (int y = MAX(r.y, 0); y < MIN(r.y + r.h, tim.h); y++) {
+            for (int x = MAX(r.x, 0); x < MIN(r.x + r.w, tim.w); x++) {
+                int i = x + y * tim.w;
+                n += !!memcmp(&tim.cells[i], &old[i], sizeof(old[i]));
+            }
+        }
+        return n;
+    }
+#endif
+    return screen_cells(r);
+}
+
+// start probe of scope entered last, always 1
+static inline int profile_enter(const char* name) {
+    struct profile* p = tim.profile;
+    if (p) {
+        struct probe* pr    = find_probe(p, name);
+        p->open[tim.scope]  = pr ? (int)(pr - p->probes) : -1;
+        p->start[tim.scope] = time_us();
+        if (pr) {
+            pr->rect = tim.scopes[tim.scope];
+        }
+    }
+    return 1;
+}
+
+// end probe of current scope level
+static void profile_exit(void) {
+    struct profile* p = tim.profile;
+    int             i = p->open[tim.scope];
+    if (i < 0 || !p->start[tim.scope]) {
+        return; // levels entered before p was attached are zero
+    }
+    struct probe* pr = &p->probes[i];
+    bool          d  = tim.event.type == DRAW_EVENT;
+    pr->calls          += 1;
+    pr->us             += time_us() - p->start[tim.scope];
+    pr->cells          += d ? changed_cells(pr->rect) : 0;
+    p->open[tim.scope]  = -1;
+    p->start[tim.scope] = 0;
+}
+
+// start of element, zero when not profiling
+static inline int64_t probe_begin(void) {
+    return tim.profile ? time_us() : 0;
+}
+
+// attribute element that started at start_us and drew r to probe name
+static inline void probe_end(const char* name, struct rect r,
+                             int64_t start_us) {
+    struct probe* pr = start_us ? find_probe(tim.profile, name) : NULL;
+    if (pr) {
+        bool d     = tim.event.type == DRAW_EVENT;
+        pr->calls += 1;
+        pr->us    += time_us() - start_us;
+        pr->cells += d ? screen_cells(r) : 0;
+    }
+}
+
+// draw heaviest probes of last frame, in place and as list in top right corner
+static void profile_overlay(struct profile* p) {
+    int order[MAX_PROBE];
+    for (int i = 0; i < p->count; i++) {
+        // insertion sort by time
+        int k = i;
+        for (; k > 0 && p->probes[order[k - 1]].last_us < p->probes[i].last_us;
+             k--) {
+            order[k] = order[k - 1];
+        }
+        order[k] = i;
+    }
+    char buf[64];
+    for (int k = 0; k < MIN(p->count, 8); k++) {
+        struct probe* pr = &p->probes[order[k]];
+        if (pr->rect.w > 0) {
+            int n = snprintf(buf, sizeof(buf), "%d %s %dus %dc", k + 1,
+                             pr->name, pr->last_us, pr->last_cells);
+            draw_str(buf, pr->rect.x, pr->rect.y, n, 0, 11);
+        }
+        snprintf(buf, sizeof(buf), "%d %-12.12s %6dus %5dc %4dx", k + 1,
+                 pr->name, pr->last_us, pr->last_cells, pr->last_calls);
+        draw_str(buf, tim.w - 38, k, 38, 11, 0);
+    }
+}
+
+// close frame of profiler and draw overlay
+static void profile_frame(struct profile* p) {
+    for (int i = 0; i < p->count; i++) {
+        struct probe* pr = &p->probes[i];
+        pr->last_calls   = pr->calls;
+        pr->last_us      = pr->us;
+        pr->last_cells   = pr->cells;
+        pr->calls = pr->us = pr->cells = 0;
+    }
+    if (p->overlay) {
+        profile_overlay(p);
+    }
+}
+
 /* scope **********************************************************************/
 
 // enter layout scope
@@ -1051,23 +3111,230 @@ static inline int enter_scope(int x, int y, int w, int h) {
     struct rect r = abs_xywh(x, y, w, h);
     tim.scope += 1;
     tim.scopes[tim.scope] = r;
+    tim.clips[tim.scope]  = clip_rect(r, tim.clips[tim.scope - 1]);
+    if (tim.profile) {
+        tim.profile->open[tim.scope] = -1;
+    }
     return 1;
 }
 
 // exit scope and pop stack
 static inline int exit_scope(void) {
+    if (tim.profile) {
+        profile_exit();
+    }
+    tim.scope -= (tim.scope > 0);
+    return 0;
+}
+
+// enter scope that is profiled under name
+#define named_scope(name, x, y, w, h)                                  \
+    for (int _i = enter_scope((x), (y), (w), (h)) && profile_enter(name); \
+         _i; _i = exit_scope())
+
+// enter scope that is skipped when key and placement did not change
+#define cached_scope(key, x, y, w, h)                                       \
+    for (int _i = enter_cached_scope(__FILE__, __LINE__, (key), (x), (y), \
+                                     (w), (h));                           \
+         _i; _i = exit_cached_scope(_i))
+
+// memo of call site, key and placement. Replaces the memo of call site and
+// placement when only the key changed, else takes a free one or the least
+// recently used. NULL when all were used in this frame or out of memory.
+static struct memo* find_memo(const char* file, int line, uint64_t key,
+                              struct rect r, struct rect c) {
+    if (!tim.memos) {
+        tim.memos = calloc(MAX_MEMO, sizeof(*tim.memos));
+    }
+    struct memo* old  = NULL; // least recently used
+    struct memo* same = NULL; // same call site and placement
+    for (int i = 0; tim.memos && i < tim.memo_count; i++) {
+        struct memo* m = &tim.memos[i];
+        bool site = m->line == line && m->file == file &&
+                    !memcmp(&m->r, &r, sizeof(r)) &&
+                    !memcmp(&m->clip, &c, sizeof(c)) && m->w == tim.w &&
+                    m->h == tim.h;
+        if (site && m->key == key) {
+            m->used = tim.frame;
+            return m;
+        }
+        same = (site && m->used != tim.frame) ? m : same;
+        old  = (!old || m->used < old->used) ? m : old;
+    }
+    struct memo* m = same;
+    if (!m && tim.memos && tim.memo_count < MAX_MEMO) {
+        m = &tim.memos[tim.memo_count++];
+    } else if (!m && old && old->used != tim.frame) {
+        m = old; // enclosing cached scopes still use memos of this frame
+    }
+    if (m) {
+        free(m->cells);
+        *m = (struct memo){.file = file, .line = line, .key = key, .r = r,
+                           .clip = c, .w = tim.w, .h = tim.h, .used = tim.frame};
+    }
+    return m;
+}
+
+// copy visible cells between screen and memo
+static void copy_memo(struct memo* m, bool save) {
+    struct rect r = m->clip;
+    for (int y = 0; y < r.h; y++) {
+        struct cell* c = &tim.cells[r.x + (r.y + y) * tim.w];
+        struct cell* s = &m->cells[y * r.w];
+        memcpy(save ? s : c, save ? c : s, r.w * sizeof(*c));
+    }
+}
+
+// Enter scope. On draw events, the body is skipped and its saved cells are
+// drawn instead when key, placement and screen size match the last time it
+// ran. Returns memo index + 1, MAX_MEMO + 1 without memo, 0 when skipped.
+static inline int enter_cached_scope(const char* file, int line, uint64_t key,
+                                     int x, int y, int w, int h) {
+    if (!enter_scope(x, y, w, h)) {
+        return 0;
+    }
+    if (tim.event.type != DRAW_EVENT) {
+        return MAX_MEMO + 1; // body handles events
+    }
+    struct rect  r = tim.scopes[tim.scope];
+    struct rect  c = tim.clips[tim.scope];
+    struct memo* m = find_memo(file, line, key, r, c);
+    if (!m) {
+        return MAX_MEMO + 1; // no memo, plain scope
+    }
+    if (m->cells) {
+        copy_memo(m, false);
+        exit_scope();
+        return 0;
+    }
+    m->cells = malloc(MAX(c.w * c.h, 1) * sizeof(struct cell));
+    return m - tim.memos + 1;
+}
+
+// save cells drawn by body of cached scope and exit scope
+static inline int exit_cached_scope(int i) {
+    if (i <= MAX_MEMO && tim.event.type == DRAW_EVENT) {
+        struct memo* m = &tim.memos[i - 1];
+        if (m->cells) {
+            copy_memo(m, true);
+        }
+    }
+    return exit_scope();
+}
+
+/* canvas *********************************************************************/
+
+// A canvas is an offscreen cell buffer. Inside a canvas block, the screen
+// buffer is replaced by the canvas, so that elements and draw functions draw
+// into it. Canvases are drawn to the screen with blit.
+
+// draw into canvas within block
+#define canvas(c) for (int _i = enter_canvas(c); _i; _i = exit_canvas(c))
+
+// allocate w * h cells, false when out of memory
+static inline bool canvas_init(struct canvas* c, int w, int h) {
+    *c       = (struct canvas){.w = MAX(w, 0), .h = MAX(h, 0)};
+    c->cells = calloc(MAX(c->w * c->h, 1), sizeof(*c->cells));
+    return c->cells != NULL;
+}
+
+static inline void canvas_free(struct canvas* c) {
+    free(c->cells);
+    c->cells = NULL;
+}
+
+// make canvas the screen buffer and root of a new scope
+static inline int enter_canvas(struct canvas* c) {
+    if (!c->cells || tim.scope + 1 >= MAX_SCOPE) {
+        return 0;
+    }
+    c->screen   = tim.cells;
+    c->screen_w = tim.w;
+    c->screen_h = tim.h;
+    tim.cells   = c->cells;
+    tim.w       = c->w;
+    tim.h       = c->h;
+    tim.scope  += 1;
+    tim.scopes[tim.scope] = (struct rect){0, 0, c->w, c->h};
+    tim.clips[tim.scope]  = tim.scopes[tim.scope];
+    return 1;
+}
+
+// restore screen buffer
+static inline int exit_canvas(struct canvas* c) {
+    tim.cells  = c->screen;
+    tim.w      = c->screen_w;
+    tim.h      = c->screen_h;
     tim.scope -= (tim.scope > 0);
     return 0;
 }
 
+// Copy w * h cells from src at sx/sy to dst at dx/dy, both may be the same
+// canvas. The rectangle is clipped to both canvases.
+static void canvas_copy(struct canvas* dst, int dx, int dy,
+                        const struct canvas* src, int sx, int sy, int w,
+                        int h) {
+    // clip left and top, then right and bottom
+    int cx = MAX(MAX(-sx, -dx), 0);
+    int cy = MAX(MAX(-sy, -dy), 0);
+    sx    += cx;
+    dx    += cx;
+    sy    += cy;
+    dy    += cy;
+    w      = MIN(w - cx, MIN(src->w - sx, dst->w - dx));
+    h      = MIN(h - cy, MIN(src->h - sy, dst->h - dy));
+    if (w <= 0 || h <= 0) {
+        return;
+    }
+    // rows may overlap when copying down within the same canvas
+    bool up = dy > sy;
+    for (int i = 0; i < h; i++) {
+        int y = up ? h - 1 - i : i;
+        memmove(&dst->cells[dx + (dy + y) * dst->w],
+                &src->cells[sx + (sy + y) * src->w], w * sizeof(struct cell));
+    }
+}
+
+// move content by dx/dy, uncovered cells are set to fill
+static inline void canvas_scroll(struct canvas* c, int dx, int dy,
+                                 struct cell fill) {
+    canvas_copy(c, dx, dy, c, 0, 0, c->w, c->h);
+    // fill cells directly, a canvas scope would replace the screen of an
+    // enclosing canvas block
+    for (int y = 0; y < c->h; y++) {
+        bool row = dy < 0 ? y >= c->h + dy : y < dy;
+        for (int x = 0; x < c->w; x++) {
+            if (row || (dx < 0 ? x >= c->w + dx : x < dx)) {
+                c->cells[x + y * c->w] = fill;
+            }
+        }
+    }
+}
+
+// draw canvas area at sx/sy to w * h cells at x/y of current scope
+static inline void blit(const struct canvas* c, int sx, int sy, int x, int y,
+                        int w, int h) {
+    if (tim.event.type == DRAW_EVENT) {
+        w = (w == A) ? c->w - sx : w;
+        h = (h == A) ? c->h - sy : h;
+        struct rect   r      = abs_xywh(x, y, w, h);
+        struct rect   v      = clip_rect(r, tim.clips[tim.scope]);
+        struct canvas screen = {.w = tim.w, .h = tim.h, .cells = tim.cells};
+        canvas_copy(&screen, v.x, v.y, c, sx + v.x - r.x, sy + v.y - r.y, v.w,
+                    v.h);
+    }
+}
+
 /* frame **********************************************************************/
 
 // frame
 // color: background, frame
 static inline void frame(int x, int y, int w, int h, uint64_t color) {
-    if (tim.event.type == DRAW_EVENT) {
-        struct rect r = abs_xywh(x, y, w, h);
+    struct rect r = abs_xywh(x, y, w, h);
+    if (tim.event.type == DRAW_EVENT && !is_clipped(r)) {
+        int64_t t = probe_begin();
         draw_box(r.x, r.y, r.w, r.h, color, color >> 8);
+        probe_end("frame", r, t);
     }
 }
 
@@ -1079,16 +3346,26 @@ static inline void frame(int x, int y, int w, int h, uint64_t color) {
 static inline void label(const char* str, int x, int y, int w, int h,
                          uint64_t color) {
     if (tim.event.type == DRAW_EVENT) {
-        struct text s = scan_str(str);
+        // skip scanning the text when the label can't be visible
+        if (tim.clips[tim.scope].w == 0 ||
+            (w != A && h != A && is_clipped(abs_xywh(x, y, w, h)))) {
+            return;
+        }
+        int64_t     t = probe_begin();
+        struct text s = (w == A || h == A) ? scan_str(str) : (struct text){0};
         w = (w == A) ? s.width : w;
         h = (h == A) ? s.lines : h;
         struct rect r = abs_xywh(x, y, w, h);
+        if (is_clipped(r)) {
+            return;
+        }
         struct cell c = cell(" ", color, color >> 8);
         draw_lot(c, r.x, r.y, r.w, r.h);
         struct line l = {.str = str, .line = ""};
         for (int i = 0; next_line(&l); i++) {
             draw_str(l.line, r.x, r.y + i, l.width, c.fg, c.bg);
         }
+        probe_end("label", r, t);
     }
 }
 
@@ -1098,81 +3375,196 @@ static inline void label(const char* str, int x, int y, int w, int h,
 // color: frame, background, text
 static inline bool button(const char* txt, int x, int y, int w, int h,
                           uint64_t color) {
-    int tw = utflen(txt);
-    w      = (w == A) ? (tw + 4) : w;
-    h      = (h == A) ? 3 : h;
+    int64_t t  = probe_begin();
+    int     tw = (w == A) ? utflen(txt) : 0;
+    w          = (w == A) ? (tw + 4) : w;
+    h          = (h == A) ? 3 : h;
     struct rect r = abs_xywh(x, y, w, h);
 
-    if (tim.event.type == DRAW_EVENT) {
+    if (tim.event.type == DRAW_EVENT && !is_clipped(r)) {
+        tw = tw ? tw : utflen(txt);
         draw_box(r.x, r.y, r.w, r.h, color >> 16, color >> 8);
         draw_str(txt, r.x + (w - tw) / 2, r.y + h / 2, w, color, color >> 8);
     }
+    probe_end("button", r, t);
     return is_click_over(r);
 }
 
 /* edit ***********************************************************************/
 
-static void edit_insert(struct edit* e, const char* s) {
-    int dst_size = ztrlen(e->str);
-    int src_size = ztrlen(s);
-    if (dst_size + src_size + 1 < (int)sizeof(e->str)) {
-        int len = utflen(s); // usually 1, except when smashing keys
-        int cur = utfpos(e->str, e->cursor);
-        memmove(e->str + cur + src_size, e->str + cur, dst_size - cur);
-        memmove(e->str + cur, s, src_size);
-        e->str[dst_size + src_size + 1] = 0;
-        e->length += len;
-        e->cursor += len;
-    }
+// bytes in gap, at least one for the terminator
+static inline int edit_gap(const struct edit* e) {
+    return e->size - 1 - e->bytes;
 }
 
-static void edit_delete(struct edit* e) {
-    int size = ztrlen(e->str);
-    int cur  = utfpos(e->str, e->cursor);
-    int len  = utfpos(e->str + cur, 1);
-    if (size - cur > 0) {
-        memmove(e->str + cur, e->str + cur + len, size - cur);
-        e->length -= 1;
-    }
+// pointer to text at byte offset i, skipping the gap
+static inline char* edit_ptr(const struct edit* e, int i) {
+    return e->buf + (i < e->gap ? i : i + edit_gap(e));
 }
 
-static bool edit_event(struct edit* e, struct rect r) {
-    if (is_click_over(r)) {
-        // take focus
-        tim.focus = (uintptr_t)e;
+// copy initial text to gap buffer
+static bool edit_init(struct edit* e) {
+    if (e->buf) {
+        return true;
+    }
+    int n   = ztrlen(e->init);
+    int len = utflen(e->init);
+    *e      = (struct edit){.init = e->init, .size = MAX(n * 2, 64)};
+    e->buf  = malloc(e->size);
+    if (!e->buf) {
         return false;
     }
+    memcpy(e->buf, e->init, n);
+    e->buf[n]           = 0;
+    e->buf[e->size - 1] = 0;
+    e->bytes            = n;
+    e->gap              = n;
+    e->pos              = n;
+    e->length           = len;
+    e->cursor           = len;
+    return true;
+}
 
-    if (tim.focus != (uintptr_t)e || tim.event.type != KEY_EVENT) {
-        // not focused or no key press
-        return false;
+// move gap to byte offset i
+static void edit_move_gap(struct edit* e, int i) {
+    int n = edit_gap(e);
+    if (i < e->gap) {
+        memmove(e->buf + i + n, e->buf + i, e->gap - i);
+    } else if (i > e->gap) {
+        memmove(e->buf + e->gap, e->buf + e->gap + n, i - e->gap);
     }
-    tim.event.type = VOID_EVENT; // consume event
+    e->gap    = i;
+    e->buf[i] = 0;
+}
 
-    switch (tim.event.key) {
-    case ENTER_KEY:
-        tim.focus = 0; // release focus
+// make room for n more bytes
+static bool edit_grow(struct edit* e, int n) {
+    if (edit_gap(e) > n) {
         return true;
-    case DELETE_KEY:
-        edit_delete(e);
+    }
+    int   size = MAX(e->size * 2, e->bytes + n + 2);
+    char* buf  = realloc(e->buf, size);
+    if (!buf) {
+        return false;
+    }
+    int tail = e->bytes - e->gap;
+    memmove(buf + size - 1 - tail, buf + e->size - 1 - tail, tail + 1);
+    e->buf  = buf;
+    e->size = size;
+    return true;
+}
+
+// byte offset of n characters before byte offset i
+static int edit_back(const struct edit* e, int i, int n) {
+    for (; i > 0 && n > 0; n--) {
+        do {
+            i -= 1;
+        } while (i > 0 && (*edit_ptr(e, i) & 192) == 128);
+    }
+    return i;
+}
+
+static void edit_insert(struct edit* e, const char* s) {
+    int size = ztrlen(s);
+    if (size > 0 && edit_grow(e, size)) {
+        int len = utflen(s); // usually 1, except when smashing keys
+        edit_move_gap(e, e->pos);
+        memcpy(e->buf + e->gap, s, size);
+        e->gap          += size;
+        e->bytes        += size;
+        e->pos          += size;
+        e->buf[e->gap]   = 0;
+        e->length       += len;
+        e->cursor       += len;
+    }
+}
+
+static void edit_delete(struct edit* e) {
+    if (e->pos < e->bytes) {
+        edit_move_gap(e, e->pos);
+        e->bytes  -= MAX(utfpos(edit_ptr(e, e->pos), 1), 1);
+        e->length -= 1;
+    }
+}
+
+static inline const char* edit_str(struct edit* e) {
+    if (!edit_init(e)) {
+        return e->init ? e->init : "";
+    }
+    edit_move_gap(e, e->bytes);
+    return e->buf;
+}
+
+static inline void edit_free(struct edit* e) {
+    free(e->buf);
+    *e = (struct edit){.init = e->init};
+}
+
+// draw text from byte offset i, text before and after the gap separately
+static void edit_draw(struct edit* e, int i, int x, int y, int w,
+                      uint64_t color) {
+    if (i < e->gap) {
+        const char* s = e->buf + i;
+        int         n = 0;
+        for (int k = 0; s[k] && n <= w; k++) {
+            n += (s[k] & 192) != 128;
+        }
+        draw_str(s, x, y, w, color, color >> 8);
+        x += n;
+        w -= n;
+        i  = e->gap;
+    }
+    if (w > 0) {
+        draw_str(edit_ptr(e, i), x, y, w, color, color >> 8);
+    }
+}
+
+static bool edit_event(struct edit* e, struct rect r) {
+    if (is_click_over(r)) {
+        // take focus
+        tim.focus = (uintptr_t)e;
+        return false;
+    }
+
+    if (tim.focus != (uintptr_t)e || tim.event.type != KEY_EVENT) {
+        // not focused or no key press
+        return false;
+    }
+    tim.event.type = VOID_EVENT; // consume event
+
+    switch (tim.event.key) {
+    case ENTER_KEY:
+        tim.focus = 0; // release focus
+        return true;
+    case DELETE_KEY:
+        edit_delete(e);
         break;
     case BACKSPACE_KEY:
         if (e->cursor > 0) {
             e->cursor -= 1;
+            e->pos     = edit_back(e, e->pos, 1);
             edit_delete(e);
         }
         break;
     case LEFT_KEY:
-        e->cursor -= (e->cursor > 0);
+        if (e->cursor > 0) {
+            e->cursor -= 1;
+            e->pos     = edit_back(e, e->pos, 1);
+        }
         break;
     case RIGHT_KEY:
-        e->cursor += (e->cursor < e->length);
+        if (e->cursor < e->length) {
+            e->cursor += 1;
+            e->pos    += MAX(utfpos(edit_ptr(e, e->pos), 1), 1);
+        }
         break;
     case HOME_KEY:
         e->cursor = 0;
+        e->pos    = 0;
         break;
     case END_KEY:
         e->cursor = e->length;
+        e->pos    = e->bytes;
         break;
     case ESCAPE_KEY:
         tim.focus = 0; // release focus
@@ -1191,26 +3583,36 @@ static bool edit_event(struct edit* e, struct rect r) {
 // e    : persistent edit state
 // color: frame, background, text
 static inline bool edit(struct edit* e, int x, int y, int w, uint64_t color) {
+    int64_t     t = probe_begin();
     struct rect r = abs_xywh(x, y, w, 3);
 
-    // uninitialized edit state
-    if (e->str[0] && e->cursor == 0 && e->length == 0) {
-        e->length = utflen(e->str);
-        e->cursor = e->length;
+    if (!edit_init(e)) {
+        probe_end("edit", r, t);
+        return false;
     }
 
-    if (tim.event.type == DRAW_EVENT) {
+    // keep cursor visible, only measures the visible part of the text
+    int vis = MAX(r.w - 4, 0);
+    if (e->cursor < e->scroll) {
+        e->scroll     = e->cursor;
+        e->scroll_pos = e->pos;
+    } else if (e->cursor > e->scroll + vis) {
+        e->scroll     = e->cursor - vis;
+        e->scroll_pos = edit_back(e, e->pos, vis);
+    }
+
+    if (tim.event.type == DRAW_EVENT && !is_clipped(r)) {
         draw_box(r.x, r.y, r.w, r.h, color >> 16, color >> 8);
         if (tim.focus == (uintptr_t)e) {
-            char* str = e->str + utfpos(e->str, e->cursor - r.w + 4);
-            int   cur = MIN(r.w - 4, e->cursor);
-            draw_str(str, r.x + 2, r.y + 1, r.w - 3, color, color >> 8);
+            int cur = e->cursor - e->scroll;
+            edit_draw(e, e->scroll_pos, r.x + 2, r.y + 1, r.w - 3, color);
             draw_invert(r.x + cur + 2, r.y + 1, 1);
         } else {
-            draw_str(e->str, r.x + 2, r.y + 1, r.w - 3, color, color >> 8);
+            edit_draw(e, 0, r.x + 2, r.y + 1, r.w - 3, color);
         }
     }
 
+    probe_end("edit", r, t);
     return edit_event(e, r);
 }
 
@@ -1222,16 +3624,18 @@ static inline bool edit(struct edit* e, int x, int y, int w, uint64_t color) {
 // color: check, background, text
 static inline bool check(const char* txt, int* state, int x, int y, int w,
                          uint64_t color) {
+    int64_t t = probe_begin();
     w = (w == A) ? utflen(txt) + 4 : w;
     struct rect r = abs_xywh(x, y, w, 1);
 
-    if (tim.event.type == DRAW_EVENT) {
+    if (tim.event.type == DRAW_EVENT && !is_clipped(r)) {
         const char* st = *state == -1 ? "-" : *state ? "x" : "  ";
         draw_str("[ ] ", r.x, r.y, 4, color, color >> 8);
         draw_str(st, r.x + 1, r.y, 1, color >> 16, color >> 8);
         draw_str(txt, r.x + 4, r.y, r.w - 4, color, color >> 8);
     }
 
+    probe_end("check", r, t);
     bool click = is_click_over(r);
     *state = click ? !*state : *state;
     return click;
@@ -1246,176 +3650,3507 @@ static inline bool check(const char* txt, int* state, int x, int y, int w,
 // color: radio, background, text
 static inline bool radio(const char* txt, int* state, int v, int x, int y,
                          int w, uint64_t color) {
+    int64_t t = probe_begin();
     w = (w == A) ? utflen(txt) + 4 : w;
     struct rect r = abs_xywh(x, y, w, 1);
 
-    if (tim.event.type == DRAW_EVENT) {
+    if (tim.event.type == DRAW_EVENT && !is_clipped(r)) {
         const char* st = *state == v ? "o" : " ";
         draw_str("( ) ", r.x, r.y, 4, color, color >> 8);
         draw_str(st, r.x + 1, r.y, 1, color >> 16, color >> 8);
         draw_str(txt, r.x + 4, r.y, r.w - 4, color, color >> 8);
     }
 
+    probe_end("radio", r, t);
     bool click = is_click_over(r);
     *state = click ? v : *state;
     return click;
 }
 
-/* rendering ******************************************************************/
+/* list ***********************************************************************/
 
-// write character to output buffer
-static inline void put_chr(char c) {
-    if (tim.buf_size + 1 < MAX_BUF) {
-        tim.buf[tim.buf_size] = c;
-        tim.buf_size += 1;
+#define LIST_WHEEL 3 // rows per wheel step
+
+// keep top and selection within count, follow moves top to the selection
+static void list_clamp(struct list* l, int count, int h, bool follow) {
+    l->selected = MAX(MIN(l->selected, count - 1), 0);
+    if (follow) {
+        l->top = MIN(l->top, l->selected);
+        l->top = MAX(l->top, l->selected - h + 1);
     }
+    l->top = MAX(MIN(l->top, count - h), 0);
 }
 
-// write string to output buffer
-static inline void put_str(const char* s, int size) {
-    if (size > 0 && tim.buf_size + size < MAX_BUF) {
-        memmove(&tim.buf[tim.buf_size], s, size);
-        tim.buf_size += size;
+static bool list_event(struct list* l, int count, struct rect r, bool bar) {
+    if (tim.event.type == MOUSE_EVENT && is_mouse_over(r)) {
+        int y = tim.event.y - r.y;
+        switch (tim.event.key) {
+        case WHEEL_UP:
+        case WHEEL_DOWN:
+            l->top += (tim.event.key == WHEEL_UP) ? -LIST_WHEEL : LIST_WHEEL;
+            list_clamp(l, count, r.h, false);
+            tim.event.type = VOID_EVENT; // consume event
+            return false;
+        case LEFT_BUTTON:
+            tim.focus = (uintptr_t)l;
+            if (bar && tim.event.x == r.x + r.w - 1) {
+                // jump to position of scroll bar
+                l->top = (int64_t)y * (count - r.h) / MAX(r.h - 1, 1);
+                list_clamp(l, count, r.h, false);
+                return false;
+            }
+            if (l->top + y < count) {
+                l->selected = l->top + y;
+                return true;
+            }
+            return false;
+        }
+    }
+
+    if (tim.focus != (uintptr_t)l || tim.event.type != KEY_EVENT) {
+        // not focused or no key press
+        return false;
+    }
+
+    switch (tim.event.key) {
+    case ENTER_KEY:
+        tim.event.type = VOID_EVENT;
+        return count > 0;
+    case ESCAPE_KEY:
+        tim.focus = 0; // release focus
+        break;
+    case UP_KEY:
+        l->selected -= 1;
+        break;
+    case DOWN_KEY:
+        l->selected += 1;
+        break;
+    case PAGEUP_KEY:
+        l->selected -= r.h;
+        break;
+    case PAGEDOWN_KEY:
+        l->selected += r.h;
+        break;
+    case HOME_KEY:
+        l->selected = 0;
+        break;
+    case END_KEY:
+        l->selected = count - 1;
+        break;
+    default:
+        return false; // leave other keys to other handlers
     }
+    tim.event.type = VOID_EVENT; // consume event
+    list_clamp(l, count, r.h, true);
+    return false;
 }
 
-// write integer as decimal string to output buffer
-static inline void put_int(int i) {
-    // optimized for small positive values, reduces load by a third
-    char* buf = &tim.buf[tim.buf_size];
-    if (tim.buf_size + 11 >= MAX_BUF) {
-        // not enough space for 32 bit integer
-    } else if ((unsigned)i < 10) {
-        buf[0] = '0' + i;
-        tim.buf_size += 1;
-    } else if ((unsigned)i < 100) {
-        buf[0] = '0' + i / 10;
-        buf[1] = '0' + i % 10;
-        tim.buf_size += 2;
-    } else if ((unsigned)i < 1000) {
-        buf[0] = '0' + i / 100;
-        buf[1] = '0' + (i / 10) % 10;
-        buf[2] = '0' + i % 10;
-        tim.buf_size += 3;
-    } else {
-        tim.buf_size += sprintf(buf, "%d", i); 
+// virtualized list - returns true when a row is clicked or return is pressed
+// l    : persistent list state
+// row  : draws row i within its scope
+// color: background, scroll bar
+static inline bool list(struct list* l, int count,
+                        void (*row)(int i, bool selected, void* data),
+                        void* data, int x, int y, int w, int h,
+                        uint64_t color) {
+    int64_t     t   = probe_begin();
+    struct rect r   = abs_xywh(x, y, w, h);
+    bool        bar = count > r.h;
+
+    list_clamp(l, count, r.h, false); // count may change between frames
+    bool ret = list_event(l, count, r, bar);
+
+    if (tim.event.type == DRAW_EVENT && !is_clipped(r)) {
+        draw_lot(cell(" ", color, color >> 8), r.x, r.y, r.w, r.h);
+        scope (x, y, w, h) {
+            struct rect c = tim.clips[tim.scope];
+            int         n = MIN(c.y + c.h - r.y, count - l->top);
+            for (int i = c.y - r.y; i < n; i++) {
+                scope (0, i, r.w - bar, 1) {
+                    row(l->top + i, l->top + i == l->selected, data);
+                }
+            }
+        }
+        if (bar) {
+            int size = MAX((int64_t)r.h * r.h / count, 1);
+            int pos  = (int64_t)l->top * (r.h - size) / (count - r.h);
+            draw_col(cell("│", color, color >> 8), r.x + r.w - 1, r.y, r.h);
+            draw_col(cell("█", color, color >> 8), r.x + r.w - 1, r.y + pos,
+                     size);
+        }
     }
+
+    probe_end("list", r, t);
+    return ret;
 }
 
-static void render(void) {
-    int  fg   = -1;
-    int  bg   = -1;
-    bool wide = false;
-    bool skip = false;
+/* table **********************************************************************/
 
-    // screen buffers
-    struct cell* new_cells = tim_cells;
-    struct cell* old_cells = tim_cells;
-#if ENABLE_DBUF
-    new_cells += (tim.frame & 1) ? MAX_CELLS : 0;
-    old_cells += (tim.frame & 1) ? 0 : MAX_CELLS;
-#endif
-    tim.buf_size = 0;
+// parse number, false for text
+static bool text_number(const char* s, double* v) {
+    // fast path for up to 15 digits, which doubles hold exactly
+    double d = 0;
+    int    n = 0;
+    for (; n < 16 && s[n] >= '0' && s[n] <= '9'; n++) {
+        d = d * 10 + (s[n] - '0');
+    }
+    if (n && n < 16 && !s[n]) {
+        *v = d;
+        return true;
+    }
+    char* e = NULL;
+    *v      = strtod(s, &e);
+    return e > s && !*e && *v == *v; // nan is text
+}
 
-    for (int i = 0; i < tim.w * tim.h; i++) {
-        struct cell c = new_cells[i];
-#if ENABLE_DBUF
-        // do nothing if cells in look-ahead are identical
-        const int la = 8; // look-ahead
-        if (!tim.resized && !(i % la) && (i + la < MAX_CELLS) &&
-            !memcmp(new_cells + i, old_cells + i, la * sizeof(c))) {
-            skip = true;
-            i    = i + la - 1;
-            continue;
+// compare strings, numbers sort before text and are compared by value
+static int compare_text(const char* a, const char* b) {
+    double da;
+    double db;
+    bool   na = text_number(a, &da);
+    bool   nb = text_number(b, &db);
+    if (na != nb) {
+        return na ? -1 : 1;
+    }
+    return na ? (da > db) - (da < db) : strcmp(a, b);
+}
+
+// number of columns shown
+static inline int table_cols(struct table* t) {
+    return MAX(MIN(t->cols, MAX_COLUMN), 0);
+}
+
+// compare data rows a and b in sort order
+static int table_compare(struct table* t, int a, int b) {
+    int col = abs(t->sort) - 1;
+    int c   = compare_text(t->text(a, col, t->data), t->text(b, col, t->data));
+    c = c ? c : (a > b) - (a < b); // total order, keeps resorting stable
+    return t->sort < 0 ? -c : c;
+}
+
+// insertion sort, fast for almost sorted order, gives up after budget moves
+static bool table_insertion_sort(struct table* t, int64_t budget) {
+    int* o = t->order;
+    for (int i = 1; i < t->count; i++) {
+        int v = o[i];
+        int j = i;
+        for (; j > 0 && table_compare(t, o[j - 1], v) > 0; j--) {
+            o[j] = o[j - 1];
+            budget -= 1;
         }
-#endif
-        // Set cursor position after a new line, after a string containing wide
-        // characters or after skipping identical cells.
-        bool new_line   = i % tim.w == 0;
-        bool wide_spill = wide && (c.n == 0 || c.buf[0] == ' ');
-        bool wide_flank = wide && !wide_spill && !c.wide;
-        if (new_line || wide_flank || skip) {
-            put_str(S("\33["));
-            put_int((i / tim.w) + 1);
-            put_chr(';');
-            put_int((i % tim.w) + 1);
-            put_chr('H');
+        o[j] = v;
+        if (budget < 0) {
+            return false;
         }
-        wide = c.wide || wide_spill;
-        skip = false;
+    }
+    return true;
+}
 
-        // change foreground color
-        if (c.fg != fg) {
-            fg = c.fg;
-            put_str(S("\33[38;5;"));
-            put_int(fg);
-            put_chr('m');
-        }
+// merge sort of o[0..n] using tmp
+static void table_merge_sort(struct table* t, int* o, int* tmp, int n) {
+    if (n < 2) {
+        return;
+    }
+    int m = n / 2;
+    table_merge_sort(t, o, tmp, m);
+    table_merge_sort(t, o + m, tmp, n - m);
+    if (table_compare(t, o[m - 1], o[m]) <= 0) {
+        return; // already in order
+    }
+    memcpy(tmp, o, m * sizeof(*o));
+    int i = 0;
+    int j = m;
+    int k = 0;
+    while (i < m && j < n) {
+        o[k++] = table_compare(t, tmp[i], o[j]) <= 0 ? tmp[i++] : o[j++];
+    }
+    while (i < m) {
+        o[k++] = tmp[i++];
+    }
+}
 
-        // change background color
-        if (c.bg != bg) {
-            bg = c.bg;
-            put_str(S("\33[48;5;"));
-            put_int(bg);
-            put_chr('m');
+// sort order, changed is true when the data changed since last sort
+static void table_sort(struct table* t, bool changed) {
+    if (t->sort == 0) {
+        for (int i = 0; i < t->count; i++) {
+            t->order[i] = i;
         }
-
-        // write character
-        if (c.n) {
-            put_str((char*)c.buf, c.n);
+        return;
+    }
+    if (t->sort == -t->sorted) {
+        // reversed order, ties are reversed too
+        for (int i = 0, j = t->count - 1; i < j; i++, j--) {
+            int v       = t->order[i];
+            t->order[i] = t->order[j];
+            t->order[j] = v;
+        }
+        t->sorted = t->sort;
+        if (!changed) {
+            return;
+        }
+    }
+    // order is almost sorted when only the data changed
+    if (t->sort != t->sorted || !table_insertion_sort(t, t->count * 4ll)) {
+        int* tmp = malloc((t->count / 2 + 1) * sizeof(int));
+        if (tmp) {
+            table_merge_sort(t, t->order, tmp, t->count);
+            free(tmp);
         } else {
-            put_chr(' ');
+            table_insertion_sort(t, INT64_MAX);
         }
     }
+}
 
-    // duration depends on connection and terminal rendering speed
-    write_str(tim.buf, tim.buf_size);
+// mark data row as changed for the next update
+static inline void table_changed(struct table* t, int row) {
+    if (t->nchanged == t->changed_cap) {
+        int  cap = MAX(t->changed_cap * 2, 16);
+        int* c   = realloc(t->changed, cap * sizeof(*c));
+        if (!c) {
+            t->valid = false; // fall back to full update
+            return;
+        }
+        t->changed     = c;
+        t->changed_cap = cap;
+    }
+    t->changed[t->nchanged++] = row;
+}
 
-    tim.resized = false;
-    tim.frame  += 1;         // frame counter
-    tim.cells   = old_cells; // swap buffer
+// measure changed rows and move them to their sorted place, false on error
+static bool table_replace(struct table* t) {
+    uint8_t* mark = calloc(t->count, 1);
+    if (!mark) {
+        return false;
+    }
+    for (int k = 0; k < t->nchanged; k++) {
+        int row = t->changed[k];
+        if (row < 0 || row >= t->count || mark[row]) {
+            continue;
+        }
+        mark[row] = 1;
+        for (int c = 0; c < table_cols(t); c++) {
+            if (t->columns[c].width == A) {
+                int w        = utflen(t->text(row, c, t->data));
+                t->widths[c] = MAX(t->widths[c], w);
+            }
+        }
+    }
+
+    // unsorted order is the identity, which changed rows keep
+    int* o = t->order;
+    int  n = 0;
+    for (int i = 0; t->sort && i < t->count; i++) {
+        o[n] = o[i];
+        n   += !mark[o[i]];
+    }
+    for (int k = 0; t->sort && k < t->nchanged; k++) {
+        int row = t->changed[k];
+        if (row < 0 || row >= t->count || !mark[row]) {
+            continue;
+        }
+        mark[row] = 0;
+        int lo    = 0;
+        int hi    = n;
+        while (lo < hi) {
+            int mid = (lo + hi) / 2;
+            if (table_compare(t, o[mid], row) < 0) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        memmove(o + lo + 1, o + lo, (n - lo) * sizeof(*o));
+        o[lo] = row;
+        n    += 1;
+    }
+    free(mark);
+    return true;
 }
 
-/* event loop *****************************************************************/
+// update permutation and column widths after the data changed
+static void table_update(struct table* t, int count, uint64_t key) {
+    bool changed = !t->valid || t->key != key || t->count != count ||
+                   t->nchanged;
+    if (!changed && t->sorted == t->sort) {
+        return;
+    }
 
-static bool tim_run(float fps) {
-    int timeout = (fps > 0) ? (int)(1000 / fps) : 0;
+    // remember selected data row
+    int sel = (t->list.selected < t->count) ? t->order[t->list.selected] : -1;
+
+    // only changed rows, when nothing else changed
+    if (t->valid && t->count == count && t->sorted == t->sort &&
+        t->nchanged && table_replace(t)) {
+        t->nchanged = 0;
+        t->key      = key;
+        for (int i = 0; sel >= 0 && i < t->count; i++) {
+            if (t->order[i] == sel) {
+                t->list.selected = i;
+                break;
+            }
+        }
+        return;
+    }
+    t->nchanged = 0;
+
+    if (count != t->count) {
+        // drop removed rows, keep order of the rest and append new rows
+        int  n   = 0;
+        int  old = t->count;
+        int* o   = t->order;
+        for (int i = 0; i < old; i++) {
+            o[n] = o[i];
+            n   += o[i] < count;
+        }
+        t->count = n;
+        o        = realloc(o, MAX(count, 1) * sizeof(int));
+        if (!o) {
+            return;
+        }
+        for (int i = old; i < count; i++) {
+            o[n++] = i;
+        }
+        t->order = o;
+        t->count = count;
+    }
 
-    while (true) {
-        switch (tim.loop_stage) {
-        case 0:
-            // runs only once
-            init_terminal();
-            atexit(reset_terminal);
-            // fallthru
-        case 1:
-            // process input event
-            tim.start_us = time_us();
-            if (tim.event.type != DRAW_EVENT) {
-                // reset focus on mouse click
-                if (is_event_key(MOUSE_EVENT, LEFT_BUTTON)) {
-                    tim.focus = 0;
-                }
-                tim.loop_stage = 2;
-                return true;
+    if (changed) {
+        for (int c = 0; c < table_cols(t); c++) {
+            const struct column* col = &t->columns[c];
+            int                  w   = utflen(col->name);
+            for (int i = 0; col->width == A && i < count; i++) {
+                w = MAX(w, utflen(t->text(i, c, t->data)));
             }
-            // fallthru
-        case 2:
-            // process draw event
-            clear_cells();
-            tim.event.type = DRAW_EVENT;
-            tim.loop_stage = 3;
-            return true;
-        case 3:
-            // render screen and wait for next event
-            render();
-            tim.render_us = time_us() - tim.start_us;
-            read_event(timeout); // blocks
-            // fallthru
-        default:
-            tim.loop_stage = 1;
+            t->widths[c] = (col->width == A) ? w : col->width;
+        }
+    }
+
+    table_sort(t, changed);
+    for (int i = 0; sel >= 0 && i < t->count; i++) {
+        if (t->order[i] == sel) {
+            t->list.selected = i;
             break;
         }
-    } // while
+    }
+    t->sorted = t->sort;
+    t->key    = key;
+    t->valid  = true;
+}
+
+static void table_row(int i, bool selected, void* data) {
+    struct table* t   = data;
+    struct rect   r   = tim.scopes[tim.scope];
+    int           row = t->order[i];
+    int           x   = r.x;
+    draw_lot(cell(" ", t->color, t->color >> 8), r.x, r.y, r.w, 1);
+    for (int c = 0; c < table_cols(t) && x < r.x + r.w; c++) {
+        draw_str(t->text(row, c, t->data), x, r.y, t->widths[c], t->color,
+                 t->color >> 8);
+        x += t->widths[c] + 1;
+    }
+    if (selected) {
+        draw_invert(r.x, r.y, r.w);
+    }
+}
+
+// table - returns true when a row is clicked or return is pressed
+// t    : persistent table state with columns and text callback
+// key  : data version
+// color: header, background, text
+static inline bool table(struct table* t, int count, uint64_t key, int x,
+                         int y, int w, int h, uint64_t color) {
+    int64_t     tm  = probe_begin();
+    struct rect r   = abs_xywh(x, y, w, h);
+    bool        ret = false;
+
+    // sort by clicked header
+    for (int c = 0, cx = r.x; t->valid && c < table_cols(t); c++) {
+        if (is_click_over((struct rect){cx, r.y, t->widths[c] + 1, 1})) {
+            t->sort = (t->sort == c + 1) ? -(c + 1) : c + 1;
+        }
+        cx += t->widths[c] + 1;
+    }
+    table_update(t, MAX(count, 0), key);
+    t->color = color;
+
+    if (tim.event.type == DRAW_EVENT && !is_clipped(r)) {
+        draw_lot(cell(" ", color >> 16, color >> 8), r.x, r.y, r.w, 1);
+        for (int c = 0, cx = r.x; c < table_cols(t); c++) {
+            const char* arrow = t->sort > 0 ? "▲" : "▼";
+            int         n     = MIN(t->widths[c], r.x + r.w - cx);
+            draw_str(t->columns[c].name, cx, r.y, n, color >> 16, color >> 8);
+            if (abs(t->sort) == c + 1 && cx + t->widths[c] < r.x + r.w) {
+                draw_str(arrow, cx + t->widths[c], r.y, 1, color >> 16,
+                         color >> 8);
+            }
+            cx += t->widths[c] + 1;
+        }
+    }
+
+    scope (x, y, w, h) {
+        uint64_t c = (color & 0xff00) | ((color >> 16) & 0xff);
+        ret = list(&t->list, t->count, table_row, t, 0, 1, ~0, ~0, c);
+    }
+
+    probe_end("table", r, tm);
+    return ret;
+}
+
+static inline void table_free(struct table* t) {
+    free(t->order);
+    free(t->changed);
+    t->order       = NULL;
+    t->count       = 0;
+    t->valid       = false;
+    t->changed     = NULL;
+    t->nchanged    = 0;
+    t->changed_cap = 0;
+}
+
+/* textarea *******************************************************************/
+
+// index of first element of sorted a that is not less than v
+static int lower_bound(const int* a, int n, int v) {
+    int lo = 0;
+    int hi = n;
+    while (lo < hi) {
+        int m = lo + (hi - lo) / 2;
+        lo    = (a[m] < v) ? m + 1 : lo;
+        hi    = (a[m] < v) ? hi : m;
+    }
+    return lo;
 }
 
+static inline const char* textarea_buf(const struct textarea* t, int b) {
+    return b ? t->add : t->str;
+}
+
+// newlines in bytes [start, start + size) of buffer b
+static int textarea_newlines(const struct textarea* t, int b, int start,
+                             int size) {
+    return lower_bound(t->nl[b], t->nl_count[b], start + size) -
+           lower_bound(t->nl[b], t->nl_count[b], start);
+}
+
+// number of lines in text
+static int textarea_lines(const struct textarea* t) {
+    struct piece* p = t->count ? &t->pieces[t->count - 1] : NULL;
+    return p ? p->line + p->lines + 1 : 1;
+}
+
+// recompute offsets and lines of pieces from i on
+static void textarea_update(struct textarea* t, int i) {
+    for (; i < t->count; i++) {
+        struct piece* p = &t->pieces[i];
+        struct piece* q = i ? p - 1 : NULL;
+        p->pos          = q ? q->pos + q->size : 0;
+        p->line         = q ? q->line + q->lines : 0;
+    }
+    struct piece* p = t->count ? &t->pieces[t->count - 1] : NULL;
+    t->bytes        = p ? p->pos + p->size : 0;
+}
+
+// index newlines of initial text
+static bool textarea_init(struct textarea* t) {
+    if (t->pieces) {
+        return true;
+    }
+    int         n   = t->size ? t->size : ztrlen(t->str);
+    int         cnt = 0;
+    const char* end = t->str + n;
+    for (const char* s = t->str; n && (s = memchr(s, '\n', end - s)); s++) {
+        cnt += 1;
+    }
+    t->nl[0]  = malloc(MAX(cnt, 1) * sizeof(int));
+    t->pieces = malloc(16 * sizeof(struct piece));
+    if (!t->nl[0] || !t->pieces) {
+        free(t->nl[0]);
+        free(t->pieces);
+        t->nl[0]  = NULL;
+        t->pieces = NULL;
+        return false;
+    }
+    cnt = 0;
+    for (const char* s = t->str; n && (s = memchr(s, '\n', end - s)); s++) {
+        t->nl[0][cnt++] = s - t->str;
+    }
+    t->size        = n;
+    t->nl_count[0] = cnt;
+    t->cap         = 16;
+    t->count       = n > 0;
+    t->pieces[0]   = (struct piece){.size = n, .lines = cnt};
+    textarea_update(t, 0);
+    t->cursor = MIN(t->cursor, t->bytes);
+    return true;
+}
+
+// index of piece containing byte offset pos, count at end of text
+static int textarea_find(const struct textarea* t, int pos) {
+    int lo = 0;
+    int hi = t->count;
+    while (lo < hi) {
+        int           m = lo + (hi - lo) / 2;
+        struct piece* p = &t->pieces[m];
+        lo              = (p->pos + p->size <= pos) ? m + 1 : lo;
+        hi              = (p->pos + p->size <= pos) ? hi : m;
+    }
+    return lo;
+}
+
+// byte at offset pos, 0 at end of text
+static char textarea_at(const struct textarea* t, int pos) {
+    int           i = textarea_find(t, pos);
+    struct piece* p = &t->pieces[i];
+    return (i < t->count) ? textarea_buf(t, p->buf)[p->start + pos - p->pos]
+                          : 0;
+}
+
+// line of byte offset pos
+static int textarea_line(const struct textarea* t, int pos) {
+    int           i = textarea_find(t, pos);
+    struct piece* p = &t->pieces[i];
+    if (i == t->count) {
+        return textarea_lines(t) - 1;
+    }
+    return p->line + textarea_newlines(t, p->buf, p->start, pos - p->pos);
+}
+
+// byte offset of first character of line
+static int textarea_line_start(const struct textarea* t, int line) {
+    if (line <= 0) {
+        return 0;
+    }
+    if (line >= textarea_lines(t)) {
+        return t->bytes;
+    }
+    // piece with newline k, which ends the previous line
+    int k  = line - 1;
+    int lo = 0;
+    int hi = t->count;
+    while (lo < hi) {
+        int           m = lo + (hi - lo) / 2;
+        struct piece* p = &t->pieces[m];
+        lo              = (p->line + p->lines <= k) ? m + 1 : lo;
+        hi              = (p->line + p->lines <= k) ? hi : m;
+    }
+    struct piece* p     = &t->pieces[lo];
+    int           first = lower_bound(t->nl[p->buf], t->nl_count[p->buf],
+                                      p->start);
+    return p->pos + t->nl[p->buf][first + k - p->line] - p->start + 1;
+}
+
+// byte offset after character at pos
+static int textarea_next(const struct textarea* t, int pos) {
+    int n = bsr8(~textarea_at(t, pos)); // leading ones are utf8 length
+    return MIN(pos + MAX(MIN(n, 4), 1), t->bytes);
+}
+
+// byte offset of character before pos
+static int textarea_prev(const struct textarea* t, int pos) {
+    do {
+        pos -= 1;
+    } while (pos > 0 && (textarea_at(t, pos) & 192) == 128);
+    return MAX(pos, 0);
+}
+
+// byte offset of column col in line, or of line end
+static int textarea_pos(const struct textarea* t, int line, int col) {
+    int pos = textarea_line_start(t, line);
+    for (; col > 0 && pos < t->bytes && textarea_at(t, pos) != '\n'; col--) {
+        pos = textarea_next(t, pos);
+    }
+    return pos;
+}
+
+// column of byte offset pos
+static int textarea_col(const struct textarea* t, int pos) {
+    int col = 0;
+    for (int i = textarea_line_start(t, textarea_line(t, pos)); i < pos;) {
+        i    = textarea_next(t, i);
+        col += 1;
+    }
+    return col;
+}
+
+// make room for n more pieces
+static bool textarea_reserve(struct textarea* t, int n) {
+    if (t->count + n > t->cap) {
+        int           cap = MAX(t->cap * 2, t->count + n);
+        struct piece* p   = realloc(t->pieces, cap * sizeof(*p));
+        if (!p) {
+            return false;
+        }
+        t->pieces = p;
+        t->cap    = cap;
+    }
+    return true;
+}
+
+// split piece i at byte offset pos, returns index of piece starting at pos
+static int textarea_split(struct textarea* t, int i, int pos) {
+    if (i == t->count || t->pieces[i].pos == pos) {
+        return i;
+    }
+    struct piece* p = &t->pieces[i];
+    int           n = pos - p->pos;
+    memmove(p + 2, p + 1, (t->count - i - 1) * sizeof(*p));
+    p[1]        = *p;
+    p[1].start += n;
+    p[1].size  -= n;
+    p[1].pos   += n;
+    p[1].lines  = textarea_newlines(t, p->buf, p[1].start, p[1].size);
+    p->size     = n;
+    p->lines   -= p[1].lines;
+    p[1].line   = p->line + p->lines;
+    t->count   += 1;
+    return i + 1;
+}
+
+// insert n bytes of s at byte offset pos
+static bool textarea_insert(struct textarea* t, int pos, const char* s,
+                            int n) {
+    if (n <= 0 || !textarea_reserve(t, 2)) {
+        return false;
+    }
+    if (t->add_size + n + 1 > t->add_cap) {
+        int   cap = MAX(t->add_cap * 2, t->add_size + n + 1024);
+        char* add = realloc(t->add, cap);
+        if (!add) {
+            return false;
+        }
+        t->add     = add;
+        t->add_cap = cap;
+    }
+    int lines = 0;
+    for (int k = 0; k < n; k++) {
+        lines += s[k] == '\n';
+    }
+    if (t->nl_count[1] + lines > t->nl_cap) {
+        int  cap = MAX(t->nl_cap * 2, t->nl_count[1] + lines + 64);
+        int* nl  = realloc(t->nl[1], cap * sizeof(int));
+        if (!nl) {
+            return false;
+        }
+        t->nl[1]  = nl;
+        t->nl_cap = cap;
+    }
+
+    // append to add buffer and its newline index
+    int start = t->add_size;
+    for (int k = 0; k < n; k++) {
+        if (s[k] == '\n') {
+            t->nl[1][t->nl_count[1]++] = start + k;
+        }
+    }
+    memcpy(t->add + start, s, n);
+    t->add_size       += n;
+    t->add[t->add_size] = 0;
+
+    int           i = textarea_find(t, pos);
+    struct piece* q = (i > 0 && (i == t->count || t->pieces[i].pos == pos))
+                          ? &t->pieces[i - 1]
+                          : NULL;
+    if (q && q->buf == 1 && q->start + q->size == start) {
+        // typing extends the last added piece
+        q->size  += n;
+        q->lines += lines;
+        textarea_update(t, i);
+        return true;
+    }
+    i = textarea_split(t, i, pos);
+    memmove(&t->pieces[i + 1], &t->pieces[i],
+            (t->count - i) * sizeof(struct piece));
+    t->pieces[i] = (struct piece){.buf = 1, .start = start, .size = n,
+                                  .lines = lines};
+    t->count    += 1;
+    textarea_update(t, i);
+    return true;
+}
+
+// delete bytes [pos, pos + n)
+static void textarea_delete(struct textarea* t, int pos, int n) {
+    n = MIN(n, t->bytes - pos);
+    if (n <= 0) {
+        return;
+    }
+    // isolate range in its own pieces and drop them
+    if (!textarea_reserve(t, 2)) {
+        return;
+    }
+    int i = textarea_split(t, textarea_find(t, pos), pos);
+    int j = textarea_split(t, textarea_find(t, pos + n), pos + n);
+    memmove(&t->pieces[i], &t->pieces[j],
+            (t->count - j) * sizeof(struct piece));
+    t->count -= j - i;
+    textarea_update(t, i);
+}
+
+static inline int textarea_read(struct textarea* t, int pos, char* buf,
+                                int size) {
+    int n = 0;
+    if (!textarea_init(t)) {
+        return 0;
+    }
+    for (int i = textarea_find(t, pos); i < t->count && n < size; i++) {
+        struct piece* p   = &t->pieces[i];
+        int           off = MAX(pos + n - p->pos, 0);
+        int           k   = MIN(p->size - off, size - n);
+        memcpy(buf + n, textarea_buf(t, p->buf) + p->start + off, k);
+        n += k;
+    }
+    return n;
+}
+
+static inline void textarea_free(struct textarea* t) {
+    free(t->add);
+    free(t->nl[0]);
+    free(t->nl[1]);
+    free(t->pieces);
+    *t = (struct textarea){.str = t->str, .size = t->size};
+}
+
+static bool textarea_event(struct textarea* t, struct rect r, int rows) {
+    int line = textarea_line(t, t->cursor);
+
+    if (tim.event.type == MOUSE_EVENT && is_mouse_over(r)) {
+        switch (tim.event.key) {
+        case WHEEL_UP:
+        case WHEEL_DOWN:
+            t->top += (tim.event.key == WHEEL_UP) ? -LIST_WHEEL : LIST_WHEEL;
+            t->top  = MAX(MIN(t->top, textarea_lines(t) - rows), 0);
+            tim.event.type = VOID_EVENT; // consume event
+            return false;
+        case LEFT_BUTTON:
+            // take focus and place cursor
+            tim.focus = (uintptr_t)t;
+            t->col    = MAX(tim.event.x - r.x - 2, 0) + t->left;
+            line      = MAX(tim.event.y - r.y - 1, 0) + t->top;
+            t->cursor = textarea_pos(t, line, t->col);
+            return false;
+        }
+    }
+
+    if (tim.focus != (uintptr_t)t || tim.event.type != KEY_EVENT) {
+        // not focused or no key press
+        return false;
+    }
+    tim.event.type = VOID_EVENT; // consume event
+
+    int  pos     = t->cursor;
+    bool changed = false;
+    switch (tim.event.key) {
+    case ESCAPE_KEY:
+        tim.focus = 0; // release focus
+        return false;
+    case UP_KEY:
+    case DOWN_KEY:
+    case PAGEUP_KEY:
+    case PAGEDOWN_KEY:
+        line     += (tim.event.key == UP_KEY)       ? -1
+                    : (tim.event.key == DOWN_KEY)   ? 1
+                    : (tim.event.key == PAGEUP_KEY) ? -rows
+                                                    : rows;
+        line      = MAX(MIN(line, textarea_lines(t) - 1), 0);
+        t->cursor = textarea_pos(t, line, t->col);
+        return false; // keep column
+    case LEFT_KEY:
+        t->cursor = textarea_prev(t, pos);
+        break;
+    case RIGHT_KEY:
+        t->cursor = textarea_next(t, pos);
+        break;
+    case HOME_KEY:
+        t->cursor = textarea_line_start(t, line);
+        break;
+    case END_KEY:
+        t->cursor = textarea_pos(t, line, INT_MAX);
+        break;
+    case DELETE_KEY:
+        changed = pos < t->bytes;
+        textarea_delete(t, pos, textarea_next(t, pos) - pos);
+        break;
+    case BACKSPACE_KEY:
+        changed   = pos > 0;
+        t->cursor = textarea_prev(t, pos);
+        textarea_delete(t, t->cursor, pos - t->cursor);
+        break;
+    case ENTER_KEY:
+        changed    = textarea_insert(t, pos, "\n", 1);
+        t->cursor += changed;
+        break;
+    default:
+        if (tim.event.key >= ' ') {
+            int n      = ztrlen(tim.event.str);
+            changed    = textarea_insert(t, pos, tim.event.str, n);
+            t->cursor += changed ? n : 0;
+        }
+        break;
+    }
+    t->col = textarea_col(t, t->cursor);
+    return changed;
+}
+
+// draw line from byte offset pos, skipping left columns
+static void textarea_draw(struct textarea* t, int pos, int x, int y, int w,
+                          uint64_t color) {
+    int skip = t->left;
+    for (int i = textarea_find(t, pos); i < t->count && w > 0; i++) {
+        struct piece* p   = &t->pieces[i];
+        const char*   s   = textarea_buf(t, p->buf) + p->start;
+        int           end = p->size;
+        for (int k = pos - p->pos; k < end && w > 0;) {
+            if (s[k] == '\n') {
+                return;
+            }
+            struct cell c = {.fg = color, .bg = color >> 8, .n = 1};
+            int         n = MIN(MAX(MIN(bsr8(~s[k]), 4), 1), end - k);
+            memcpy(c.buf, s + k, n);
+            c.n    = n;
+            c.buf[0] = (n == 1 && c.buf[0] < ' ') ? ' ' : c.buf[0];
+            c.wide = is_wide_perhaps(c.buf, c.n);
+            if (skip > 0) {
+                skip -= 1;
+            } else {
+                draw_chr(c, x, y);
+                x += 1;
+                w -= 1;
+            }
+            k += n;
+        }
+        pos = p->pos + p->size;
+    }
+}
+
+// multi line text edit - returns true when text changed
+// t    : persistent textarea state
+// color: frame, background, text
+static inline bool textarea(struct textarea* t, int x, int y, int w, int h,
+                            uint64_t color) {
+    int64_t     tm = probe_begin();
+    struct rect r  = abs_xywh(x, y, w, h);
+    int         vw = MAX(r.w - 4, 1); // visible columns, one for cursor
+    int         vh = MAX(r.h - 2, 1); // visible lines
+
+    if (!textarea_init(t)) {
+        probe_end("textarea", r, tm);
+        return false;
+    }
+    int  cursor  = t->cursor;
+    bool changed = textarea_event(t, r, vh);
+
+    // scroll to cursor when it moved
+    int line = textarea_line(t, t->cursor);
+    int col  = textarea_col(t, t->cursor);
+    if (changed || cursor != t->cursor) {
+        t->top  = MIN(MAX(t->top, line - vh + 1), line);
+        t->left = MIN(MAX(t->left, col - vw), col);
+    }
+
+    if (tim.event.type == DRAW_EVENT && !is_clipped(r)) {
+        struct rect c = clip_rect(r, tim.clips[tim.scope]);
+        int         n = MIN(c.y + c.h - r.y - 1, vh);
+        draw_box(r.x, r.y, r.w, r.h, color >> 16, color >> 8);
+        for (int i = MAX(c.y - r.y - 1, 0); i < n; i++) {
+            if (t->top + i < textarea_lines(t)) {
+                int pos = textarea_line_start(t, t->top + i);
+                textarea_draw(t, pos, r.x + 2, r.y + 1 + i, vw + 1, color);
+            }
+        }
+        if (tim.focus == (uintptr_t)t) {
+            draw_invert(r.x + 2 + col - t->left, r.y + 1 + line - t->top, 1);
+        }
+    }
+
+    probe_end("textarea", r, tm);
+    return changed;
+}
+
+/* tree ***********************************************************************/
+
+// Rows hold the visible nodes in display order. Expanding a node inserts the
+// rows of its visible subtree below it, collapsing removes them, so the cost
+// depends on the rows that change and not on the size of the tree.
+
+// depth of row entry v
+static int tree_depth(struct tree* t, int v) {
+    return v >= 0 ? t->nodes[v].depth : t->nodes[-2 - v].depth + 1;
+}
+
+// row of node, -1 when not visible
+static int tree_row(struct tree* t, int node) {
+    int hint = t->nodes[node].row;
+    if (hint >= 0 && hint < t->nrows && t->rows[hint] == node) {
+        return hint;
+    }
+    for (int n = t->nodes[node].parent; n >= 0; n = t->nodes[n].parent) {
+        if (!t->nodes[n].expanded) {
+            return -1;
+        }
+    }
+    for (int i = 0; i < t->nrows; i++) {
+        if (t->rows[i] == node) {
+            t->nodes[node].row = i;
+            return i;
+        }
+    }
+    return -1;
+}
+
+// make room for n rows at pos, false when out of memory
+static bool tree_open_rows(struct tree* t, int pos, int n) {
+    if (t->nrows + n > t->rows_cap) {
+        int  cap  = MAX(MAX(t->rows_cap * 2, t->nrows + n), 64);
+        int* rows = realloc(t->rows, cap * sizeof(*rows));
+        if (!rows) {
+            return false;
+        }
+        t->rows     = rows;
+        t->rows_cap = cap;
+    }
+    memmove(t->rows + pos + n, t->rows + pos,
+            (t->nrows - pos) * sizeof(*t->rows));
+    // selection follows its row
+    t->list.selected += (t->list.selected >= pos && pos < t->nrows) ? n : 0;
+    t->nrows         += n;
+    return true;
+}
+
+// rows of visible subtree of expanded node, written to out unless NULL
+static int tree_walk(struct tree* t, int node, int* out) {
+    struct tree_node* nd = t->nodes;
+    if (nd[node].state == TREE_LOADING) {
+        if (out) {
+            out[0] = -2 - node; // placeholder
+        }
+        return 1;
+    }
+    int n = 0;
+    int c = nd[node].first;
+    while (c >= 0) {
+        if (out) {
+            out[n] = c;
+        }
+        n += 1;
+        if (nd[c].expanded && nd[c].state == TREE_LOADING) {
+            if (out) {
+                out[n] = -2 - c;
+            }
+            n += 1;
+        } else if (nd[c].expanded && nd[c].first >= 0) {
+            c = nd[c].first;
+            continue;
+        }
+        while (c != node && nd[c].next < 0) {
+            c = nd[c].parent;
+        }
+        c = (c == node) ? -1 : nd[c].next;
+    }
+    return n;
+}
+
+// insert rows of node at row
+static void tree_show(struct tree* t, int node, int row) {
+    int n = tree_walk(t, node, NULL);
+    if (tree_open_rows(t, row + 1, n)) {
+        tree_walk(t, node, t->rows + row + 1);
+        for (int i = row + 1; i <= row + n; i++) {
+            if (t->rows[i] >= 0) {
+                t->nodes[t->rows[i]].row = i;
+            }
+        }
+    }
+}
+
+// remove rows below row that are deeper
+static void tree_hide(struct tree* t, int row) {
+    int depth = tree_depth(t, t->rows[row]);
+    int end   = row + 1;
+    while (end < t->nrows && tree_depth(t, t->rows[end]) > depth) {
+        end++;
+    }
+    memmove(t->rows + row + 1, t->rows + end,
+            (t->nrows - end) * sizeof(*t->rows));
+    t->nrows -= end - row - 1;
+    if (t->list.selected >= end) {
+        t->list.selected -= end - row - 1;
+    } else if (t->list.selected > row) {
+        t->list.selected = row;
+    }
+}
+
+// add child of parent, -1 for a root, returns node or -1 when out of memory
+static inline int tree_add(struct tree* t, int parent, const char* text,
+                           uint64_t id, bool folder) {
+    if (t->count == t->cap) {
+        int               cap   = MAX(t->cap * 2, 64);
+        struct tree_node* nodes = realloc(t->nodes, cap * sizeof(*nodes));
+        if (!nodes) {
+            return -1;
+        }
+        t->nodes = nodes;
+        t->cap   = cap;
+    }
+    int   size = strlen(text) + 1;
+    char* copy = malloc(size);
+    if (!copy) {
+        return -1;
+    }
+    memcpy(copy, text, size);
+
+    int               node = t->count++;
+    struct tree_node* n    = &t->nodes[node];
+    *n = (struct tree_node){
+        .text   = copy,
+        .id     = id,
+        .parent = parent,
+        .first  = -1,
+        .last   = -1,
+        .next   = -1,
+        .depth  = parent < 0 ? 0 : t->nodes[parent].depth + 1,
+        .row    = -1,
+        .state  = folder ? TREE_UNLOADED : TREE_LEAF,
+    };
+    if (parent >= 0) {
+        struct tree_node* p = &t->nodes[parent];
+        if (p->last >= 0) {
+            t->nodes[p->last].next = node;
+        } else {
+            p->first = node;
+        }
+        p->last = node;
+    }
+
+    // show node when its parent shows children, below their rows
+    int pos = -1;
+    if (parent < 0) {
+        pos = t->nrows;
+    } else if (t->nodes[parent].expanded &&
+               t->nodes[parent].state == TREE_LOADED) {
+        int row = tree_row(t, parent);
+        for (pos = row + 1; row >= 0 && pos < t->nrows &&
+                            tree_depth(t, t->rows[pos]) > n->depth - 1;
+             pos++) {}
+        pos = row >= 0 ? pos : -1;
+    }
+    if (pos >= 0 && tree_open_rows(t, pos, 1)) {
+        t->rows[pos] = node;
+    }
+    return node;
+}
+
+// expand or collapse node, children are loaded on first expand
+static inline void tree_expand(struct tree* t, int node, bool expand) {
+    if (t->nodes[node].state == TREE_LEAF ||
+        t->nodes[node].expanded == expand) {
+        return;
+    }
+    int row = tree_row(t, node);
+    if (row >= 0 && !expand) {
+        tree_hide(t, row);
+    }
+    t->nodes[node].expanded = expand;
+    if (expand && t->nodes[node].state == TREE_UNLOADED) {
+        t->nodes[node].state = TREE_LOADING;
+        if (!t->load || t->load(t, node, t->data)) {
+            t->nodes[node].state = TREE_LOADED;
+        }
+    }
+    if (row >= 0 && expand) {
+        tree_show(t, node, row);
+    }
+}
+
+// children of node are added, replaces placeholder of pending load
+static inline void tree_done(struct tree* t, int node) {
+    if (t->nodes[node].state != TREE_LOADING) {
+        return;
+    }
+    t->nodes[node].state = TREE_LOADED;
+    int row = tree_row(t, node);
+    if (row >= 0 && t->nodes[node].expanded) {
+        tree_hide(t, row);
+        tree_show(t, node, row);
+    }
+}
+
+// selected node, -1 for none or a placeholder
+static inline int tree_selected(struct tree* t) {
+    int i = t->list.selected;
+    return (i < t->nrows && t->rows[i] >= 0) ? t->rows[i] : -1;
+}
+
+static inline void tree_free(struct tree* t) {
+    for (int i = 0; i < t->count; i++) {
+        free(t->nodes[i].text);
+    }
+    free(t->nodes);
+    free(t->rows);
+    *t = (struct tree){.load = t->load, .data = t->data};
+}
+
+static void tree_event(struct tree* t, struct rect r) {
+    if (tim.event.type == MOUSE_EVENT && tim.event.key == LEFT_BUTTON &&
+        is_mouse_over(r)) {
+        // click on marker toggles
+        int i = t->list.top + tim.event.y - r.y;
+        int v = i < t->nrows ? t->rows[i] : -1;
+        if (v >= 0 && t->nodes[v].state != TREE_LEAF &&
+            tim.event.x == r.x + t->nodes[v].depth * 2) {
+            t->list.selected = i;
+            tree_expand(t, v, !t->nodes[v].expanded);
+            tim.focus      = (uintptr_t)&t->list; // take focus
+            tim.event.type = VOID_EVENT;          // consume event
+        }
+        return;
+    }
+
+    if (tim.focus != (uintptr_t)&t->list || tim.event.type != KEY_EVENT ||
+        t->nrows == 0) {
+        // not focused or no key press
+        return;
+    }
+
+    int i = t->list.selected;
+    int v = t->rows[i];
+    v     = v >= 0 ? v : -2 - v; // placeholder acts as its node
+    struct tree_node* n = &t->nodes[v];
+    switch (tim.event.key) {
+    case RIGHT_KEY:
+        if (n->state != TREE_LEAF && !n->expanded) {
+            tree_expand(t, v, true);
+        } else if (i + 1 < t->nrows &&
+                   tree_depth(t, t->rows[i + 1]) > tree_depth(t, t->rows[i])) {
+            t->list.selected = i + 1; // first child
+        }
+        break;
+    case LEFT_KEY:
+        if (n->expanded) {
+            tree_expand(t, v, false);
+        } else if (n->parent >= 0) {
+            t->list.selected = tree_row(t, n->parent);
+        }
+        break;
+    case ' ':
+        tree_expand(t, v, !n->expanded);
+        break;
+    default:
+        return; // leave other keys to list
+    }
+    tim.event.type = VOID_EVENT; // consume event
+    list_clamp(&t->list, t->nrows, r.h, true);
+}
+
+static void tree_draw_row(int i, bool selected, void* data) {
+    struct tree* t = data;
+    struct rect  r = tim.scopes[tim.scope];
+    int          v = t->rows[i];
+    int          x = r.x + tree_depth(t, v) * 2;
+    draw_lot(cell(" ", t->color, t->color >> 8), r.x, r.y, r.w, 1);
+    if (v < 0) {
+        draw_str("…", x, r.y, MAX(r.x + r.w - x, 0), t->color, t->color >> 8);
+    } else {
+        struct tree_node* n = &t->nodes[v];
+        const char* marker = n->state == TREE_LEAF ? " " : n->expanded ? "▾"
+                                                                       : "▸";
+        n->row = i;
+        draw_str(marker, x, r.y, MAX(r.x + r.w - x, 0), t->color,
+                 t->color >> 8);
+        draw_str(n->text, x + 2, r.y, MAX(r.x + r.w - x - 2, 0), t->color,
+                 t->color >> 8);
+    }
+    if (selected) {
+        draw_invert(r.x, r.y, r.w);
+    }
+}
+
+// tree view - returns true when a row is clicked or return is pressed
+// t    : persistent tree state with load callback
+// color: background, text
+static inline bool tree(struct tree* t, int x, int y, int w, int h,
+                        uint64_t color) {
+    int64_t     tm = probe_begin();
+    struct rect r  = abs_xywh(x, y, w, h);
+
+    list_clamp(&t->list, t->nrows, r.h, false);
+    tree_event(t, r);
+    t->color = color;
+    bool ret = list(&t->list, t->nrows, tree_draw_row, t, x, y, w, h, color);
+
+    probe_end("tree", r, tm);
+    return ret;
+}
+
+/* chart **********************************************************************/
+
+// Samples are merged into buckets of per samples, aligned to the sample count,
+// so a pushed sample only changes the last bucket. Buckets are rebuilt from
+// the ring when the width changes.
+
+static const char* chart_blocks[] = {" ", "▁", "▂", "▃", "▄",
+                                     "▅", "▆", "▇", "█"};
+
+// append n samples, false when out of memory
+static inline bool chart_push(struct chart* c, const float* v, int n) {
+    if (!c->ring) {
+        c->size = MAX(c->size, 1);
+        c->ring = malloc(c->size * sizeof(*c->ring));
+        if (!c->ring) {
+            return false;
+        }
+    }
+    for (int i = MAX(n - c->size, 0); i < n;) {
+        int pos = (c->total + i) % c->size;
+        int k   = MIN(n - i, c->size - pos);
+        memcpy(c->ring + pos, v + i, k * sizeof(*v));
+        i += k;
+    }
+    c->total += n;
+    return true;
+}
+
+static inline void chart_free(struct chart* c) {
+    free(c->ring);
+    free(c->mins);
+    free(c->maxs);
+    *c = (struct chart){.size = c->size, .min = c->min, .max = c->max};
+}
+
+// minimum and maximum of n > 0 values
+static void minmax(const float* a, int n, float* lo, float* hi) {
+    float l = a[0];
+    float h = a[0];
+    int   i = 0;
+#ifdef TIM_SSE2
+    if (n >= 4) {
+        __m128 vl = _mm_loadu_ps(a);
+        __m128 vh = vl;
+        for (i = 4; i + 4 <= n; i += 4) {
+            __m128 v = _mm_loadu_ps(a + i);
+            vl       = _mm_min_ps(vl, v);
+            vh       = _mm_max_ps(vh, v);
+        }
+        float bl[4];
+        float bh[4];
+        _mm_storeu_ps(bl, vl);
+        _mm_storeu_ps(bh, vh);
+        l = MIN(MIN(bl[0], bl[1]), MIN(bl[2], bl[3]));
+        h = MAX(MAX(bh[0], bh[1]), MAX(bh[2], bh[3]));
+    }
+#endif
+    for (; i < n; i++) {
+        l = MIN(l, a[i]);
+        h = MAX(h, a[i]);
+    }
+    *lo = l;
+    *hi = h;
+}
+
+// merge samples pushed since last draw into cols buckets
+static bool chart_build(struct chart* c, int cols) {
+    int  per   = MAX((c->size + cols - 1) / cols, 1);
+    bool fresh = false;
+    if (cols != c->cols || per != c->per) {
+        float* mins = realloc(c->mins, cols * sizeof(*mins));
+        float* maxs = mins ? realloc(c->maxs, cols * sizeof(*maxs)) : NULL;
+        c->mins     = mins ? mins : c->mins;
+        c->maxs     = maxs ? maxs : c->maxs;
+        c->cols     = maxs ? cols : 0;
+        if (!maxs) {
+            return false;
+        }
+        c->per   = per;
+        c->built = MAX(c->total - c->size, 0);
+        c->start = c->built;
+        fresh    = true;
+    }
+    if (c->total - c->built > c->size) {
+        // missed samples are gone, start over with the ring
+        c->built = c->total - c->size;
+        c->start = c->built;
+        fresh    = true;
+    }
+    for (int64_t i = c->built; i < c->total;) {
+        int64_t k   = i / per;
+        int     n   = MIN((k + 1) * per, c->total) - i;
+        int     pos = i % c->size;
+        int     n1  = MIN(n, c->size - pos);
+        float   lo;
+        float   hi;
+        minmax(c->ring + pos, n1, &lo, &hi);
+        if (n > n1) {
+            float lo2;
+            float hi2;
+            minmax(c->ring, n - n1, &lo2, &hi2);
+            lo = MIN(lo, lo2);
+            hi = MAX(hi, hi2);
+        }
+        int slot = k % cols;
+        if (fresh || i == k * per) {
+            c->mins[slot] = lo;
+            c->maxs[slot] = hi;
+        } else {
+            c->mins[slot] = MIN(c->mins[slot], lo);
+            c->maxs[slot] = MAX(c->maxs[slot], hi);
+        }
+        fresh = false;
+        i    += n;
+    }
+    c->built = c->total;
+    return true;
+}
+
+// bucket shown in column i of cols, -1 when empty
+static int chart_slot(struct chart* c, int i) {
+    int64_t k = (c->total - 1) / c->per - c->cols + 1 + i;
+    bool    ok = c->total > 0 && k >= c->start / c->per &&
+                 (k + 1) * c->per > c->total - c->size;
+    return ok ? k % c->cols : -1;
+}
+
+// dot row of value v in a plot of n dots, 0 at the top
+static int chart_dot(struct chart* c, float v, int n) {
+    // lo + 1 rounds to lo for big values, constant samples stay at the bottom
+    float d = c->hi - c->lo;
+    float y = (d > 0) ? (c->hi - v) / d * (n - 1) + 0.5f : n - 1;
+    y       = (y >= 0) ? MIN(y, n - 1) : 0; // clamp as float, false for NaN
+    return (int)y;
+}
+
+// chart of last size samples
+// c    : persistent chart state with samples
+// color: background, line
+static inline void chart(struct chart* c, int x, int y, int w, int h,
+                         uint64_t color) {
+    int64_t     t = probe_begin();
+    struct rect r = abs_xywh(x, y, w, h);
+
+    // a line of blocks or braille with 2x4 dots per cell
+    int cols = (r.h == 1) ? r.w : r.w * 2;
+    if (tim.event.type == DRAW_EVENT && !is_clipped(r)) {
+        draw_lot(cell(" ", color, color >> 8), r.x, r.y, r.w, r.h);
+    }
+    if (tim.event.type == DRAW_EVENT && !is_clipped(r) && c->ring &&
+        cols > 0 && chart_build(c, cols)) {
+        bool any = false;
+        c->lo    = c->min;
+        c->hi    = c->max;
+        for (int i = 0; c->min == c->max && i < cols; i++) {
+            int s = chart_slot(c, i);
+            if (s >= 0) {
+                c->lo = any ? MIN(c->lo, c->mins[s]) : c->mins[s];
+                c->hi = any ? MAX(c->hi, c->maxs[s]) : c->maxs[s];
+                any   = true;
+            }
+        }
+        c->hi = (c->hi > c->lo) ? c->hi : c->lo + 1;
+
+        if (r.h == 1) {
+            for (int i = 0; i < cols; i++) {
+                int s = chart_slot(c, i);
+                if (s >= 0) {
+                    int level = 8 - chart_dot(c, c->maxs[s], 9);
+                    draw_chr(cell(chart_blocks[level], color, color >> 8),
+                             r.x + i, r.y);
+                }
+            }
+        } else {
+            static const uint8_t bits[2][4] = {{0x01, 0x02, 0x04, 0x40},
+                                               {0x08, 0x10, 0x20, 0x80}};
+            int dots = r.h * 4;
+            int top[2];
+            int bot[2];
+            int prev_top = -1;
+            int prev_bot = -1;
+            for (int cx = 0; cx < r.w; cx++) {
+                // dot range of both halves, joined to the previous bucket
+                for (int j = 0; j < 2; j++) {
+                    int s = chart_slot(c, cx * 2 + j);
+                    top[j] = bot[j] = -1;
+                    if (s >= 0) {
+                        top[j] = chart_dot(c, c->maxs[s], dots);
+                        bot[j] = chart_dot(c, c->mins[s], dots);
+                        if (prev_top >= 0) {
+                            top[j] = MIN(top[j], prev_bot);
+                            bot[j] = MAX(bot[j], prev_top);
+                        }
+                        prev_top = chart_dot(c, c->maxs[s], dots);
+                        prev_bot = chart_dot(c, c->mins[s], dots);
+                    }
+                }
+                int from = (top[0] < 0) ? top[1] : (top[1] < 0) ? top[0]
+                                                 : MIN(top[0], top[1]);
+                int to   = MAX(bot[0], bot[1]);
+                for (int cy = MAX(from, 0) / 4; from >= 0 && cy <= to / 4;
+                     cy++) {
+                    uint8_t b = 0;
+                    for (int j = 0; j < 2; j++) {
+                        for (int d = 0; top[j] >= 0 && d < 4; d++) {
+                            int dy = cy * 4 + d;
+                            b     |= (dy >= top[j] && dy <= bot[j]) ? bits[j][d]
+                                                                    : 0;
+                        }
+                    }
+                    char buf[4] = {0xe2, 0xa0 | (b >> 6), 0x80 | (b & 63)};
+                    draw_chr(cell(buf, color, color >> 8), r.x + cx, r.y + cy);
+                }
+            }
+        }
+    }
+
+    probe_end("chart", r, t);
+}
+
+/* rendering ******************************************************************/
+
+// write character to output buffer
+static inline void put_chr(char c) {
+    if (tim.buf_size + 1 < MAX_BUF) {
+        tim.buf[tim.buf_size] = c;
+        tim.buf_size += 1;
+    }
+}
+
+// write string to output buffer
+static inline void put_str(const char* s, int size) {
+    if (size > 0 && tim.buf_size + size < MAX_BUF) {
+        memmove(&tim.buf[tim.buf_size], s, size);
+        tim.buf_size += size;
+    }
+}
+
+// write integer as decimal string to output buffer
+static inline void put_int(int i) {
+    // optimized for small positive values, reduces load by a third
+    char* buf = &tim.buf[tim.buf_size];
+    if (tim.buf_size + 11 >= MAX_BUF) {
+        // not enough space for 32 bit integer
+    } else if ((unsigned)i < 10) {
+        buf[0] = '0' + i;
+        tim.buf_size += 1;
+    } else if ((unsigned)i < 100) {
+        buf[0] = '0' + i / 10;
+        buf[1] = '0' + i % 10;
+        tim.buf_size += 2;
+    } else if ((unsigned)i < 1000) {
+        buf[0] = '0' + i / 100;
+        buf[1] = '0' + (i / 10) % 10;
+        buf[2] = '0' + i % 10;
+        tim.buf_size += 3;
+    } else {
+        tim.buf_size += sprintf(buf, "%d", i); 
+    }
+}
+
+// Move previous frame to the new row stride, so that unchanged cells can still
+// be diffed after a width or height change. Cells the terminal may have lost or
+// garbled are marked invalid and never compare equal to a drawn cell. When both
+// width and height change, everything is repainted.
+static void reflow_cells(struct cell* c, int ow, int oh, int w, int h) {
+    struct cell inv = {.wide = 0xff}; // invalid cell
+    if (ow != w && oh != h) {
+        for (int i = 0; i < w * h; i++) {
+            c[i] = inv;
+        }
+        return;
+    }
+    int cw = MIN(ow, w);
+    int ch = MIN(oh, h);
+    if (w > ow) {
+        // rows move apart, start at bottom
+        for (int y = ch - 1; y >= 0; y--) {
+            memmove(c + y * w, c + y * ow, cw * sizeof(*c));
+        }
+    } else {
+        // rows move together, start at top
+        for (int y = 0; y < ch; y++) {
+            memmove(c + y * w, c + y * ow, cw * sizeof(*c));
+        }
+    }
+    // last old column may have held a clipped wide character
+    int x0 = (w != ow) ? cw - 1 : w;
+    for (int y = 0; y < h; y++) {
+        for (int x = (y < oh) ? MAX(x0, 0) : 0; x < w; x++) {
+            c[x + y * w] = inv;
+        }
+    }
+}
+
+// Encode cells into output buffer. Only cells that differ from old are
+// written, all of them when old is NULL. Both buffers have w * h cells. Work
+// done is added to st unless it is NULL.
+static void encode_cells(const struct cell* new_cells,
+                         const struct cell* old_cells, int w, int h,
+                         struct counters* st) {
+    int  fg      = -1;
+    int  bg      = -1;
+    bool wide    = false;
+    bool skip    = false;
+    int  emitted = 0;
+    int  moves   = 0;
+    int  sgr     = 0;
+
+    for (int i = 0; i < w * h; i++) {
+        struct cell c = new_cells[i];
+        // do nothing if cells in look-ahead are identical
+        const int la = 8; // look-ahead
+        if (old_cells && !(i % la) && (i + la <= w * h) &&
+            !memcmp(new_cells + i, old_cells + i, la * sizeof(c))) {
+            skip = true;
+            i    = i + la - 1;
+            continue;
+        }
+        // Set cursor position after a new line, after a string containing wide
+        // characters or after skipping identical cells.
+        bool new_line   = i % w == 0;
+        bool wide_spill = wide && (c.n == 0 || c.buf[0] == ' ');
+        bool wide_flank = wide && !wide_spill && !c.wide;
+        if (new_line || wide_flank || skip) {
+            put_str(S("\33["));
+            put_int((i / w) + 1);
+            put_chr(';');
+            put_int((i % w) + 1);
+            put_chr('H');
+            moves += 1;
+        }
+        wide     = c.wide || wide_spill;
+        skip     = false;
+        emitted += 1;
+
+        // change foreground color
+        if (c.fg != fg) {
+            fg   = c.fg;
+            sgr += 1;
+            put_str(S("\33[38;5;"));
+            put_int(fg);
+            put_chr('m');
+        }
+
+        // change background color
+        if (c.bg != bg) {
+            bg   = c.bg;
+            sgr += 1;
+            put_str(S("\33[48;5;"));
+            put_int(bg);
+            put_chr('m');
+        }
+
+        // write character
+        if (c.n) {
+            put_str((char*)c.buf, c.n);
+        } else {
+            put_chr(' ');
+        }
+    }
+
+    // Park cursor in home position. Some terminals scroll the screen when it
+    // shrinks below the cursor row, which would break the reflowed diff.
+    if (tim.buf_size) {
+        put_str(S("\33[H"));
+    }
+
+    if (st) {
+        st->cells_diffed  += old_cells ? w * h : 0;
+        st->cells_emitted += emitted;
+        st->cursor_moves  += moves;
+        st->sgr_changes   += sgr;
+    }
+}
+
+// Close frame counters and move the window of average and maximum by one
+// frame. The sum is updated in place, the maximum is taken over the window.
+static void update_stats(void) {
+    struct stats*   st  = &tim.stats;
+    struct counters old = st->ring[st->next];
+    const int       n   = sizeof(struct counters) / sizeof(int);
+    int*            f   = (int*)&st->frame;
+    int*            o   = (int*)&old;
+    int*            s   = (int*)&st->sum;
+    int*            a   = (int*)&st->avg;
+    int*            m   = (int*)&st->max;
+    st->ring[st->next] = st->frame;
+    st->next           = (st->next + 1) % MAX_STATS;
+    st->frames         = MIN(st->frames + 1, MAX_STATS);
+    for (int i = 0; i < n; i++) {
+        s[i] += f[i] - o[i];
+        a[i]  = s[i] / st->frames;
+        m[i]  = 0;
+    }
+    for (int k = 0; k < st->frames; k++) {
+        int* r = (int*)&st->ring[k];
+        for (int i = 0; i < n; i++) {
+            m[i] = MAX(m[i], r[i]);
+        }
+    }
+    st->last  = st->frame;
+    st->frame = (struct counters){0};
+}
+
+// histogram bucket of value, exact below 16 then 16 buckets per power of 2
+static int latency_bucket(int64_t v) {
+    v = MIN(MAX(v, 0), INT32_MAX);
+    if (v < 16) {
+        return (int)v;
+    }
+    int k = 4;
+    while (v >> (k + 1)) {
+        k += 1;
+    }
+    return (k - 3) * 16 + (int)((v >> (k - 4)) & 15);
+}
+
+// largest value of histogram bucket
+static int64_t latency_value(int i) {
+    if (i < 16) {
+        return i;
+    }
+    int k = i / 16 + 3;
+    return ((int64_t)(16 + i % 16 + 1) << (k - 4)) - 1;
+}
+
+// remember read time of current event if it is input that changes the screen
+static void start_latency(void) {
+    int type = tim.event.type;
+    if (type == KEY_EVENT || type == MOUSE_EVENT || tim.resized) {
+        tim.pending_kind = type == KEY_EVENT     ? KEY_LATENCY
+                           : type == MOUSE_EVENT ? MOUSE_LATENCY
+                                                 : RESIZE_LATENCY;
+        tim.pending_us   = tim.read_us;
+    }
+}
+
+// record latency of pending input, called when its frame is written
+static void end_latency(void) {
+    if (!tim.pending_us) {
+        return;
+    }
+    int64_t         us = time_us() - tim.pending_us;
+    struct latency* l  = &tim.latency[tim.pending_kind];
+    l->count          += 1;
+    l->max             = MAX(l->max, us);
+    l->buckets[latency_bucket(us)] += 1;
+    tim.pending_us = 0;
+}
+
+// latency in microseconds at percentile p (0-100) of histogram kind, 0 if empty
+static inline int64_t latency_percentile(int kind, double p) {
+    struct latency* l    = &tim.latency[kind];
+    double          rank = l->count * MIN(MAX(p, 0), 100) / 100;
+    int64_t         want = (int64_t)rank;
+    want                += want < rank; // nearest rank, rounded up
+    want                 = MIN(MAX(want, 1), l->count);
+    int64_t         seen = 0;
+    for (int i = 0; i < MAX_LATENCY && l->count; i++) {
+        seen += l->buckets[i];
+        if (seen >= want) {
+            return MIN(latency_value(i), l->max);
+        }
+    }
+    return 0;
+}
+
+// clear latency histogram kind
+static inline void latency_reset(int kind) {
+    memset(&tim.latency[kind], 0, sizeof(tim.latency[kind]));
+}
+
+#ifdef TIM_UNIX
+struct mirror;
+static void mirror_frame(struct mirror* m, const struct cell* c, int w, int h);
+#endif
+struct cast;
+static bool cast_started(struct cast* c);
+static void cast_frame(struct cast* c, int w, int h, const char* s, int n);
+
+static void render(void) {
+    // screen buffers
+    struct cell* new_cells = tim.dbuf;
+    struct cell* old_cells = NULL;
+#if ENABLE_DBUF
+    old_cells  = tim.dbuf;
+    new_cells += (tim.frame & 1) ? MAX_CELLS : 0;
+    old_cells += (tim.frame & 1) ? 0 : MAX_CELLS;
+    if (tim.w != tim.frame_w || tim.h != tim.frame_h) {
+        reflow_cells(old_cells, tim.frame_w, tim.frame_h, tim.w, tim.h);
+    }
+#endif
+    tim.frame_w = tim.w;
+    tim.frame_h = tim.h;
+
+    struct counters* st = &tim.stats.frame;
+    int64_t          t0 = time_us();
+    st->ui_us           = t0 - tim.start_us;
+
+    // repaint everything when a recording starts
+    const struct cell* diff = old_cells;
+    if (tim.cast && !cast_started(tim.cast)) {
+        diff = NULL;
+    }
+
+    tim.buf_size = 0;
+    trace("encode") encode_cells(new_cells, diff, tim.w, tim.h, st);
+    int64_t t1    = time_us();
+    st->encode_us = t1 - t0;
+
+    // duration depends on connection and terminal rendering speed
+    if (tim.queue_output) {
+        tim.buf_sent = 0; // written without blocking by serve_run
+    } else {
+        trace("write") write_str(tim.buf, tim.buf_size);
+        st->bytes   += tim.buf_size;
+        st->writes  += 1;
+        st->write_us = time_us() - t1;
+        end_latency();
+    }
+
+#ifdef TIM_UNIX
+    if (tim.mirror) {
+        mirror_frame(tim.mirror, new_cells, tim.w, tim.h);
+    }
+#endif
+
+    if (tim.cast) {
+        cast_frame(tim.cast, tim.w, tim.h, tim.buf, tim.buf_size);
+    }
+
+    update_stats();
+    tim.resized = false;
+    tim.frame  += 1;                                 // frame counter
+    tim.cells   = old_cells ? old_cells : new_cells; // swap buffer
+}
+
+// last rendered frame of current context
+static struct cell* last_frame(void) {
+#if ENABLE_DBUF
+    return tim.dbuf + (((tim.frame - 1) & 1) ? MAX_CELLS : 0);
+#else
+    return tim.dbuf;
+#endif
+}
+
+// number of emulated cells that differ from last frame, -1 if size differs
+static inline int vt_check(void) {
+    struct vt*         vt = tim.vt;
+    const struct cell* c  = last_frame();
+    if (!vt || vt->w != tim.frame_w || vt->h != tim.frame_h) {
+        return -1;
+    }
+    int n = 0;
+    for (int i = 0; i < vt->w * vt->h; i++) {
+        struct cell want = c[i].n ? c[i] : cell(" ", c[i].fg, c[i].bg);
+        struct cell got  = vt->cells[i];
+        n += want.fg != got.fg || want.bg != got.bg || want.n != got.n ||
+             memcmp(want.buf, got.buf, want.n);
+    }
+    return n;
+}
+
+/* event loop *****************************************************************/
+
+// Advance loop stages of current context. Returns true when the application
+// has to run a pass, false when the next event has to be read.
+static bool next_pass(void) {
+    trace_pass_end();
+    switch (tim.loop_stage) {
+    case 1:
+        // process input event
+        tim.start_us            = time_us();
+        tim.stats.frame.events += 1;
+        if (tim.poll_size) {
+            update_screen_size();
+            tim.read_us = tim.resized ? tim.start_us : tim.read_us;
+        }
+        if (tim.record) {
+            record_event();
+        }
+        start_latency();
+        if (tim.event.type != DRAW_EVENT) {
+            // reset focus on mouse click
+            if (is_event_key(MOUSE_EVENT, LEFT_BUTTON)) {
+                tim.focus = 0;
+            }
+            tim.loop_stage          = 2;
+            tim.stats.frame.passes += 1;
+            trace_pass_begin();
+            return true;
+        }
+        // fallthru
+    case 2:
+        // process draw event
+        trace("clear") clear_cells();
+        tim.event.type          = DRAW_EVENT;
+        tim.loop_stage          = 3;
+        tim.stats.frame.passes += 1;
+        trace_pass_begin();
+        return true;
+    case 3:
+        // render screen
+        if (tim.profile) {
+            profile_frame(tim.profile);
+        }
+        render();
+        tim.render_us  = time_us() - tim.start_us;
+        tim.loop_stage = 4;
+        // fallthru
+    default:
+        // wait for next event
+        return false;
+    }
+}
+
+static inline bool tim_run(float fps) {
+    int timeout = (fps > 0) ? (int)(1000 / fps) : 0;
+
+    if (tim.loop_stage == 0) {
+        // runs only once
+        init_terminal();
+        init_events();
+        if (tim_ctx == &tim_state) {
+            atexit(reset_default);
+        }
+        tim.loop_stage = 1;
+    }
+
+    while (!next_pass()) {
+        if (tim.replay) {
+            if (!read_replay()) {
+                return false; // end of recording
+            }
+        } else if (!tim.vt) {
+            trace("wait") read_event(timeout); // blocks
+        } else if (!read_script()) {
+            return false; // end of headless script
+        }
+        tim.loop_stage = 1;
+    }
+    return true;
+}
+
+/* server *********************************************************************/
+
+#ifdef TIM_UNIX
+
+struct session {
+    struct state* s;       // session context
+    bool          owned;   // descriptor accepted by server
+    bool          writing; // output queued, waiting for writable
+    int           slot;    // stable slot, see server.slots
+    uint32_t      gen;     // generation, tells reused slots apart
+};
+
+struct server {
+    int            listen_fd;             // unix socket if listening
+    bool           listening;             // listen_fd is open
+    int            epoll_fd;              // epoll backend, 0 before first use
+    int            count;                 // number of sessions
+    struct session sessions[MAX_SESSION]; // sessions
+    int            slots[MAX_SESSION];    // session index + 1, 0 when free
+    uint32_t       gen;                   // generation of last session
+    struct state*  active;                // session in the middle of a pass
+    struct state*  drop;                  // session to end after its pass
+    int            next;                  // round robin start
+    int64_t        tick_us;               // next frame deadline
+};
+
+// write queued output without blocking, 1 when everything was written, 0
+// when the rest would block, -1 on error like a viewer that hung up
+static int flush_output(void) {
+    while (tim.buf_sent < tim.buf_size) {
+        ssize_t n = write_fd(tim.fd_out, tim.buf + tim.buf_sent,
+                             tim.buf_size - tim.buf_sent);
+        if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK &&
+            errno != EINTR) {
+            return -1;
+        }
+        if (n <= 0) {
+            return 0;
+        }
+        tim.buf_sent           += n;
+        tim.stats.frame.bytes  += n;
+        tim.stats.frame.writes += 1;
+    }
+    end_latency();
+    return 1;
+}
+
+// epoll data of session, generation and slot
+static inline uint64_t serve_tag(struct session* ss) {
+    return (uint64_t)ss->gen << 32 | (uint32_t)ss->slot;
+}
+
+// update io interest of session i
+static void serve_watch(struct server* srv, int i) {
+    struct session* ss = &srv->sessions[i];
+    bool            w  = ss->writing;
+#ifdef TIM_EPOLL
+    int fds[]  = {ss->s->fd_in, ss->s->fd_out};
+    int evs[]  = {w ? 0 : EPOLLIN, w ? EPOLLOUT : 0};
+    evs[0]    |= (fds[0] == fds[1]) ? evs[1] : 0;
+    for (int k = 0; k < 1 + (fds[0] != fds[1]); k++) {
+        struct epoll_event ev = {.events = evs[k], .data.u64 = serve_tag(ss)};
+        epoll_ctl(srv->epoll_fd, EPOLL_CTL_MOD, fds[k], &ev);
+    }
+#else
+    (void)w; // interest is collected on every wait
+#endif
+}
+
+static inline struct state* serve_add_fd(struct server* srv, int in, int out,
+                                         bool owned) {
+    if (srv->count >= MAX_SESSION) {
+        return NULL;
+    }
+    struct state* s = tim_open(in, out);
+    if (!s) {
+        return NULL;
+    }
+    fcntl(in, F_SETFL, fcntl(in, F_GETFL) | O_NONBLOCK);
+    fcntl(out, F_SETFL, fcntl(out, F_GETFL) | O_NONBLOCK);
+    context (s) {
+        tim.queue_output = true;
+        init_terminal();
+        if (!tim.w) {
+            // no tty, ask terminal for its size and assume vt100 until then
+            write_str(S("\33[18t"));
+            set_screen_size(80, 24);
+        }
+        tim.loop_stage = 1; // first pass draws
+    }
+#ifdef TIM_EPOLL
+    if (!srv->epoll_fd) {
+        srv->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    }
+#endif
+    int slot = 0;
+    while (srv->slots[slot]) {
+        slot++; // a slot is free while count < MAX_SESSION
+    }
+    struct session* ss = &srv->sessions[srv->count];
+    *ss = (struct session){.s = s, .owned = owned, .slot = slot,
+                           .gen = ++srv->gen};
+    srv->slots[slot] = srv->count + 1;
+#ifdef TIM_EPOLL
+    int fds[] = {in, out};
+    for (int k = 0; k < 1 + (in != out); k++) {
+        struct epoll_event ev = {.events = 0, .data.u64 = serve_tag(ss)};
+        epoll_ctl(srv->epoll_fd, EPOLL_CTL_ADD, fds[k], &ev);
+    }
+#endif
+    serve_watch(srv, srv->count);
+    srv->count += 1;
+    return s;
+}
+
+// add session on terminal file descriptors, NULL on error
+static inline struct state* serve_add(struct server* srv, int in, int out) {
+    return serve_add_fd(srv, in, out, false);
+}
+
+// listen for sessions on unix socket, false on error
+static inline bool serve_listen(struct server* srv, const char* path) {
+    struct sockaddr_un addr = {.sun_family = AF_UNIX};
+    if (ztrlen(path) >= (int)sizeof(addr.sun_path)) {
+        return false;
+    }
+    strcpy(addr.sun_path, path);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return false;
+    }
+    fcntl(fd, F_SETFL, O_NONBLOCK);
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+    unlink(path);
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) ||
+        listen(fd, SOMAXCONN)) {
+        close(fd);
+        return false;
+    }
+    srv->listen_fd = fd;
+    srv->listening = true;
+#ifdef TIM_EPOLL
+    if (!srv->epoll_fd) {
+        srv->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    }
+    struct epoll_event ev = {.events = EPOLLIN, .data.u64 = UINT64_MAX};
+    epoll_ctl(srv->epoll_fd, EPOLL_CTL_ADD, fd, &ev);
+#endif
+    return true;
+}
+
+// end current session after the current pass
+static inline void serve_drop(struct server* srv) {
+    srv->drop = tim_ctx;
+}
+
+// remove session i
+static void serve_remove(struct server* srv, int i) {
+    struct session ss = srv->sessions[i];
+#ifdef TIM_EPOLL
+    epoll_ctl(srv->epoll_fd, EPOLL_CTL_DEL, ss.s->fd_in, NULL);
+    epoll_ctl(srv->epoll_fd, EPOLL_CTL_DEL, ss.s->fd_out, NULL);
+#endif
+    int in  = ss.s->fd_in;
+    int out = ss.s->fd_out;
+    tim_close(ss.s);
+    if (ss.owned) {
+        close(in);
+        if (out != in) {
+            close(out);
+        }
+    }
+    srv->count          -= 1;
+    srv->sessions[i]     = srv->sessions[srv->count];
+    srv->slots[ss.slot]  = 0;
+    if (i < srv->count) {
+        srv->slots[srv->sessions[i].slot] = i + 1;
+    }
+    srv->active          = (srv->active == ss.s) ? NULL : srv->active;
+    srv->drop            = (srv->drop == ss.s) ? NULL : srv->drop;
+}
+
+// index of session with context s, or -1
+static int serve_find(struct server* srv, struct state* s) {
+    for (int i = 0; i < srv->count; i++) {
+        if (srv->sessions[i].s == s) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// session io is ready, false if session hung up
+static bool serve_io(struct server* srv, int i, bool in, bool out, bool err) {
+    struct session* ss = &srv->sessions[i];
+    tim_use(ss->s);
+    if (err) {
+        return false; // hangup is reported even while waiting to write
+    }
+    if (out && ss->writing) {
+        int r = flush_output();
+        if (r < 0) {
+            return false;
+        }
+        ss->writing = !r;
+        serve_watch(srv, i);
+    }
+    if (in && !ss->writing && tim.loop_stage == 4) {
+        memset(&tim.event, 0, sizeof(tim.event));
+        int n = read(tim.fd_in, tim.event.str, sizeof(tim.event.str) - 1);
+        tim.read_us = time_us();
+        if (n == 0 || (n < 0 && errno != EAGAIN && errno != EINTR)) {
+            return false;
+        }
+        if (n > 0 && parse_input(&tim.event, n)) {
+            tim.loop_stage = 1;
+        }
+    }
+    return true;
+}
+
+// accept connection on listening socket
+static void serve_accept(struct server* srv) {
+    int fd = accept(srv->listen_fd, NULL, NULL);
+    if (fd >= 0) {
+        fcntl(fd, F_SETFD, FD_CLOEXEC);
+#ifdef SO_NOSIGPIPE
+        int one = 1; // clients may go away any time
+        setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one));
+#endif
+        if (!serve_add_fd(srv, fd, fd, true)) {
+            close(fd);
+        }
+    }
+}
+
+// wait for io on all sessions and listening socket
+static void serve_wait(struct server* srv, int timeout_ms) {
+#ifdef TIM_EPOLL
+    struct epoll_event evs[64];
+    int n = epoll_wait(srv->epoll_fd, evs, ARRAY_SIZE(evs), timeout_ms);
+    for (int k = 0; k < n; k++) {
+        uint64_t tag = evs[k].data.u64;
+        if (tag == UINT64_MAX) {
+            serve_accept(srv);
+            continue;
+        }
+        // session may be gone, removed by an earlier event of this batch
+        int  i   = srv->slots[(uint32_t)tag] - 1;
+        i        = (i >= 0 && srv->sessions[i].gen == tag >> 32) ? i : -1;
+        bool err = evs[k].events & (EPOLLERR | EPOLLHUP);
+        bool in  = evs[k].events & EPOLLIN;
+        bool out = evs[k].events & EPOLLOUT;
+        if (i >= 0 && !serve_io(srv, i, in, out, err)) {
+            serve_remove(srv, i);
+        }
+    }
+#else
+    // portable backend, interest is collected on every wait
+    static struct pollfd pfd[MAX_SESSION * 2 + 1];
+    int n = 0;
+    for (int i = 0; i < srv->count; i++) {
+        struct session* ss = &srv->sessions[i];
+        pfd[n++] = (struct pollfd){
+            .fd     = ss->writing ? ss->s->fd_out : ss->s->fd_in,
+            .events = ss->writing ? POLLOUT : POLLIN,
+        };
+    }
+    pfd[n++] = (struct pollfd){.fd = srv->listening ? srv->listen_fd : -1,
+                               .events = POLLIN};
+    if (poll(pfd, n, timeout_ms) <= 0) {
+        return;
+    }
+    // walk backwards, removal moves the last session into the gap
+    for (int i = srv->count - 1; i >= 0; i--) {
+        short r   = pfd[i].revents;
+        bool  in  = r & POLLIN;
+        bool  out = r & POLLOUT;
+        bool  err = r & (POLLERR | POLLHUP | POLLNVAL);
+        if (r && !serve_io(srv, i, in, out, err)) {
+            serve_remove(srv, i);
+        }
+    }
+    if (pfd[n - 1].revents & POLLIN) {
+        serve_accept(srv);
+    }
+#endif
+}
+
+static inline bool serve_run(struct server* srv, float fps) {
+    int64_t period = (fps > 0) ? (int64_t)(1000000 / fps) : 0;
+
+    while (true) {
+        // continue session in the middle of a pass
+        if (srv->active) {
+            tim_use(srv->active);
+            if (srv->drop != srv->active && next_pass()) {
+                return true;
+            }
+            int i = serve_find(srv, srv->active);
+            if (srv->drop == srv->active) {
+                serve_remove(srv, i);
+            } else if (tim.buf_sent < tim.buf_size) {
+                // frame rendered, write what fits
+                int r = flush_output();
+                if (r < 0) {
+                    serve_remove(srv, i);
+                } else {
+                    srv->sessions[i].writing = !r;
+                    serve_watch(srv, i);
+                }
+            }
+            srv->active = NULL;
+        }
+
+        // pick next session with a pending event
+        for (int k = 0; k < srv->count && !srv->active; k++) {
+            int i = (srv->next + k) % srv->count;
+            if (srv->sessions[i].s->loop_stage == 1) {
+                srv->active = srv->sessions[i].s;
+                srv->next   = i + 1;
+            }
+        }
+        if (srv->active) {
+            continue;
+        }
+        tim_use(NULL);
+
+        if (!srv->count && !srv->listening) {
+            return false;
+        }
+
+        // wait for io or next frame
+        int64_t now     = time_us();
+        int     timeout = -1;
+        if (period) {
+            srv->tick_us = srv->tick_us ? srv->tick_us : now + period;
+            timeout      = (int)MAX((srv->tick_us - now + 999) / 1000, 0);
+        }
+        trace("wait") serve_wait(srv, timeout);
+
+        if (period && time_us() >= srv->tick_us) {
+            // frame is due, sessions that are behind skip it
+            srv->tick_us += period;
+            srv->tick_us  = MAX(srv->tick_us, time_us());
+            for (int i = 0; i < srv->count; i++) {
+                struct state* s = srv->sessions[i].s;
+                if (s->loop_stage == 4 && !srv->sessions[i].writing) {
+                    memset(&s->event, 0, sizeof(s->event));
+                    s->loop_stage = 1;
+                }
+            }
+        }
+    } // while
+}
+
+#endif // TIM_UNIX
+
+/* mirror *********************************************************************/
+
+#ifdef TIM_UNIX
+
+// encoded difference between two frames, shared by viewers
+struct delta {
+    int   base;  // frame the difference is based on, -1 for full repaint
+    int   frame; // frame the difference leads to
+    int   refs;  // viewers writing this delta
+    int   size;  // bytes in buf
+    char* buf;   // escape sequences
+};
+
+struct viewer {
+    int           fd;   // output, non-blocking
+    int           base; // last frame fully written, -1 for none
+    struct delta* d;    // delta being written
+    int           sent; // bytes of delta written
+};
+
+struct mirror {
+    int           frame;                 // latest frame, 0 for none
+    int           w;                     // screen width of latest frame
+    int           h;                     // screen height of latest frame
+    struct cell*  history[MAX_HISTORY];  // frames, indexed by frame number
+    int           sizes[MAX_HISTORY];    // w and h of frames, packed
+    int           count;                 // number of viewers
+    struct viewer viewers[MAX_VIEWER];   // viewers
+    struct delta  deltas[MAX_VIEWER + 1]; // encodings in use or cached
+    char*         scratch;               // encoding buffer, MAX_BUF bytes
+};
+
+// add viewer, false when full
+static inline bool mirror_add(struct mirror* m, int fd) {
+    if (m->count >= MAX_VIEWER) {
+        return false;
+    }
+#ifdef SO_NOSIGPIPE
+    int one = 1; // viewers may go away any time
+    setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one));
+#endif
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    // initial screen setup is short enough to not block
+    ssize_t _ = write_fd(fd, S("\33[?1049h\33[?25l\33[2J"));
+    (void)_; // remove unused-result warning
+    m->viewers[m->count] = (struct viewer){.fd = fd, .base = -1};
+    m->count += 1;
+    return true;
+}
+
+// delta from base to latest frame, encoded on first request
+static struct delta* mirror_delta(struct mirror* m, int base) {
+    struct delta* free_d = NULL;
+    for (int i = 0; i < (int)ARRAY_SIZE(m->deltas); i++) {
+        struct delta* d = &m->deltas[i];
+        if (d->buf && d->base == base && d->frame == m->frame) {
+            return d;
+        }
+        if (!d->refs && (!free_d || !free_d->buf)) {
+            free_d = d; // prefer empty slot, otherwise reuse stale one
+        }
+    }
+    if (!free_d) {
+        return NULL;
+    }
+
+    // current frame is missing when out of memory
+    int                size = m->w << 16 | m->h;
+    int                fi   = m->frame % MAX_HISTORY;
+    if (!m->history[fi] || m->sizes[fi] != size) {
+        return NULL;
+    }
+
+    // base frame must still be in history and have the same size
+    int                bi   = base % MAX_HISTORY;
+    const struct cell* old  = NULL;
+    if (base > 0 && m->frame - base < MAX_HISTORY && m->sizes[bi] == size) {
+        old = m->history[bi];
+    } else {
+        base = -1;
+    }
+
+    // encode into scratch buffer, the context output may still be queued
+    m->scratch = m->scratch ? m->scratch : malloc(MAX_BUF);
+    if (!m->scratch) {
+        return NULL;
+    }
+    char* buf  = tim.buf;
+    int   used = tim.buf_size;
+    tim.buf      = m->scratch;
+    tim.buf_size = 0;
+    encode_cells(m->history[fi], old, m->w, m->h, NULL);
+    int   n    = tim.buf_size;
+    tim.buf      = buf;
+    tim.buf_size = used;
+
+    char* copy = realloc(free_d->buf, MAX(n, 1));
+    if (!copy) {
+        return NULL;
+    }
+    memcpy(copy, m->scratch, n);
+    *free_d = (struct delta){
+        .base  = base,
+        .frame = m->frame,
+        .size  = n,
+        .buf   = copy,
+    };
+    return free_d;
+}
+
+// write pending deltas and start new ones without blocking
+static void mirror_flush(struct mirror* m) {
+    for (int i = m->count - 1; i >= 0; i--) {
+        struct viewer* v = &m->viewers[i];
+        if (!v->d && v->base != m->frame && m->frame) {
+            // idle viewer is behind, skip to latest frame
+            v->d    = mirror_delta(m, v->base);
+            v->sent = 0;
+            if (v->d) {
+                v->d->refs += 1;
+            }
+        }
+        while (v->d && v->sent < v->d->size) {
+            ssize_t n = write_fd(v->fd, v->d->buf + v->sent,
+                                 v->d->size - v->sent);
+            if (n < 0 && errno == EAGAIN) {
+                break;
+            } else if (n <= 0) {
+                // viewer went away
+                v->d->refs -= 1;
+                close(v->fd);
+                m->count -= 1;
+                *v        = m->viewers[m->count];
+                v         = NULL;
+                break;
+            }
+            v->sent += n;
+        }
+        if (v && v->d && v->sent == v->d->size) {
+            v->base     = v->d->frame;
+            v->d->refs -= 1;
+            v->d        = NULL;
+        }
+    }
+}
+
+// store frame in history and send it to viewers
+static void mirror_frame(struct mirror* m, const struct cell* c, int w, int h) {
+    m->frame += 1;
+    m->w      = w;
+    m->h      = h;
+    int i     = m->frame % MAX_HISTORY;
+    if (m->sizes[i] != (w << 16 | h)) {
+        free(m->history[i]);
+        m->history[i] = malloc(w * h * sizeof(*c) + 1);
+        m->sizes[i]   = m->history[i] ? (w << 16 | h) : 0;
+    }
+    if (m->history[i]) {
+        memcpy(m->history[i], c, w * h * sizeof(*c));
+    }
+    mirror_flush(m);
+}
+
+#endif // TIM_UNIX
+
+/* threads ********************************************************************/
+
+// Background workers guard their state with a lock and one condition
+// variable, signals wake all waiters. Threads call a function with argument.
+
+struct monitor {
+#ifdef TIM_UNIX
+    pthread_mutex_t lock;
+    pthread_cond_t  cond;
+#endif
+#ifdef TIM_WINDOWS
+    CRITICAL_SECTION   lock;
+    CONDITION_VARIABLE cond;
+#endif
+};
+
+struct thread {
+    void (*run)(void*); // thread function
+    void* arg;          // argument passed to run
+#ifdef TIM_UNIX
+    pthread_t handle;
+#endif
+#ifdef TIM_WINDOWS
+    HANDLE handle;
+#endif
+};
+
+// false on error
+static bool monitor_init(struct monitor* m) {
+#ifdef TIM_UNIX
+    if (pthread_mutex_init(&m->lock, NULL)) {
+        return false;
+    }
+    if (pthread_cond_init(&m->cond, NULL)) {
+        pthread_mutex_destroy(&m->lock);
+        return false;
+    }
+#endif
+#ifdef TIM_WINDOWS
+    InitializeCriticalSection(&m->lock);
+    InitializeConditionVariable(&m->cond);
+#endif
+    return true;
+}
+
+static void monitor_free(struct monitor* m) {
+#ifdef TIM_UNIX
+    pthread_cond_destroy(&m->cond);
+    pthread_mutex_destroy(&m->lock);
+#endif
+#ifdef TIM_WINDOWS
+    DeleteCriticalSection(&m->lock);
+#endif
+}
+
+static void monitor_lock(struct monitor* m) {
+#ifdef TIM_UNIX
+    pthread_mutex_lock(&m->lock);
+#endif
+#ifdef TIM_WINDOWS
+    EnterCriticalSection(&m->lock);
+#endif
+}
+
+static void monitor_unlock(struct monitor* m) {
+#ifdef TIM_UNIX
+    pthread_mutex_unlock(&m->lock);
+#endif
+#ifdef TIM_WINDOWS
+    LeaveCriticalSection(&m->lock);
+#endif
+}
+
+// wait for signal or ms milliseconds, no timeout when ms < 0, lock is held
+static void monitor_wait(struct monitor* m, int ms) {
+#ifdef TIM_UNIX
+    if (ms < 0) {
+        pthread_cond_wait(&m->cond, &m->lock);
+        return;
+    }
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_nsec += ms * 1000000l;
+    ts.tv_sec  += ts.tv_nsec / 1000000000;
+    ts.tv_nsec %= 1000000000;
+    pthread_cond_timedwait(&m->cond, &m->lock, &ts);
+#endif
+#ifdef TIM_WINDOWS
+    SleepConditionVariableCS(&m->cond, &m->lock, ms < 0 ? INFINITE : ms);
+#endif
+}
+
+static void monitor_signal(struct monitor* m) {
+#ifdef TIM_UNIX
+    pthread_cond_broadcast(&m->cond);
+#endif
+#ifdef TIM_WINDOWS
+    WakeAllConditionVariable(&m->cond);
+#endif
+}
+
+#ifdef TIM_UNIX
+static void* thread_main(void* p) {
+    struct thread* t = p;
+    t->run(t->arg);
+    return NULL;
+}
+#endif
+
+#ifdef TIM_WINDOWS
+static DWORD WINAPI thread_main(LPVOID p) {
+    struct thread* t = p;
+    t->run(t->arg);
+    return 0;
+}
+#endif
+
+// start thread calling run(arg), t must not move, false on error
+static bool thread_start(struct thread* t, void (*run)(void*), void* arg) {
+    t->run = run;
+    t->arg = arg;
+#ifdef TIM_UNIX
+    return !pthread_create(&t->handle, NULL, thread_main, t);
+#endif
+#ifdef TIM_WINDOWS
+    t->handle = CreateThread(NULL, 0, thread_main, t, 0, NULL);
+    return t->handle;
+#endif
+}
+
+// wait for thread to end
+static void thread_join(struct thread* t) {
+#ifdef TIM_UNIX
+    pthread_join(t->handle, NULL);
+#endif
+#ifdef TIM_WINDOWS
+    WaitForSingleObject(t->handle, INFINITE);
+    CloseHandle(t->handle);
+#endif
+}
+
+/* asciicast ******************************************************************/
+
+// Rendered frames are recorded as asciicast v2 stream. Render only copies the
+// output into a buffer, a background thread formats and writes it. Should the
+// writer fall more than MAX_CAST bytes behind, render waits for it.
+
+struct chunk {
+    int64_t us;   // time
+    int32_t n;    // size of output following record
+    int16_t w;    // screen width
+    int16_t h;    // screen height
+    char    type; // 'h' header, 'r' resize, 'o' output
+};
+
+struct cast {
+    FILE*          f;        // output stream
+    int64_t        start_us; // start of recording
+    int            w;        // screen width, zero before first frame
+    int            h;        // screen height
+    char*          front;    // records added by render
+    char*          back;     // records being written
+    int            size;     // bytes in front buffer
+    bool           stop;     // writer ends when front buffer is empty
+    struct thread  thread;   // writer
+    struct monitor lock;     // protects front, size and stop, signaled on
+                             // records added, buffer swapped or stop
+};
+
+// bytes of valid utf8 sequence at s with n bytes left, 0 when invalid
+static int utfvalid(const char* s, int n) {
+    uint8_t c = s[0];
+    int     k = (c < 128) ? 1 : bsr8(~c); // leading ones are the length
+    if (k > n || (c >= 128 && (c < 0xc2 || c > 0xf4))) {
+        return 0; // cut off, continuation, overlong or past U+10FFFF
+    }
+    // second byte rules out overlong forms, surrogates and past U+10FFFF
+    uint8_t lo = (c == 0xe0) ? 0xa0 : (c == 0xf0) ? 0x90 : 0x80;
+    uint8_t hi = (c == 0xed) ? 0x9f : (c == 0xf4) ? 0x8f : 0xbf;
+    for (int i = 1; i < k; i++) {
+        uint8_t b = s[i];
+        if (b < (i == 1 ? lo : 0x80) || b > (i == 1 ? hi : 0xbf)) {
+            return 0;
+        }
+    }
+    return k;
+}
+
+// write output as json string, invalid utf8 bytes become U+FFFD
+static void cast_escape(FILE* f, const char* s, int n) {
+    fputc('"', f);
+    for (int i = 0; i < n; i++) {
+        uint8_t c = s[i];
+        int     k = utfvalid(s + i, n - i);
+        if (c == '"' || c == '\\') {
+            fputc('\\', f);
+            fputc(c, f);
+        } else if (c < ' ' || c == 127) {
+            fprintf(f, "\\u%04x", c);
+        } else if (!k) {
+            fputs("\\ufffd", f);
+        } else {
+            fwrite(s + i, 1, k, f);
+            i += k - 1;
+        }
+    }
+    fputc('"', f);
+}
+
+// format records of back buffer
+static void cast_write(struct cast* c, int size) {
+    FILE* f = c->f;
+    for (int i = 0; i < size;) {
+        struct chunk r;
+        memcpy(&r, c->back + i, sizeof(r));
+        const char* s = c->back + i + sizeof(r);
+        double      t = (r.us - c->start_us) / 1e6;
+        i += sizeof(r) + r.n;
+        if (r.type == 'h') {
+            fprintf(f,
+                    "{\"version\": 2, \"width\": %d, \"height\": %d, "
+                    "\"timestamp\": %lld}\n",
+                    r.w, r.h, (long long)time(NULL));
+        } else if (r.type == 'r') {
+            fprintf(f, "[%.6f, \"r\", \"%dx%d\"]\n", t, r.w, r.h);
+        } else {
+            fprintf(f, "[%.6f, \"o\", ", t);
+            cast_escape(f, s, r.n);
+            fputs("]\n", f);
+        }
+    }
+    fflush(f);
+}
+
+// writer thread, swaps buffers and writes back buffer until stopped
+static void cast_run(void* arg) {
+    struct cast* c = arg;
+    while (true) {
+        monitor_lock(&c->lock);
+        while (!c->size && !c->stop) {
+            monitor_wait(&c->lock, -1);
+        }
+        char* b  = c->back;
+        int   n  = c->size;
+        c->back  = c->front;
+        c->front = b;
+        c->size  = 0;
+        bool end = c->stop && !n;
+        monitor_signal(&c->lock); // front buffer has room again
+        monitor_unlock(&c->lock);
+        if (end) {
+            return;
+        }
+        cast_write(c, n);
+    }
+}
+
+// add record and n bytes of output, waits while writer is behind
+static void cast_push(struct cast* c, char type, int w, int h, const char* s,
+                      int n) {
+    struct chunk r = {time_us(), n, w, h, type};
+    int           m = sizeof(r) + n;
+    monitor_lock(&c->lock);
+    while (c->size + m > MAX_CAST) {
+        monitor_wait(&c->lock, -1);
+    }
+    memcpy(c->front + c->size, &r, sizeof(r));
+    memcpy(c->front + c->size + sizeof(r), s, n);
+    c->size += m;
+    monitor_signal(&c->lock);
+    monitor_unlock(&c->lock);
+}
+
+// true after first frame was recorded
+static bool cast_started(struct cast* c) {
+    return c->w > 0;
+}
+
+// record frame output, called by render
+static void cast_frame(struct cast* c, int w, int h, const char* s, int n) {
+    if (!cast_started(c)) {
+        cast_push(c, 'h', w, h, "", 0);
+        cast_push(c, 'o', w, h, S("\33[?25l\33[2J")); // hide cursor, clear
+    } else if (w != c->w || h != c->h) {
+        cast_push(c, 'r', w, h, "", 0);
+    }
+    c->w = w;
+    c->h = h;
+    if (n > 0) {
+        cast_push(c, 'o', w, h, s, n);
+    }
+}
+
+// start asciicast recording to f, NULL on error
+static inline struct cast* cast_open(FILE* f) {
+    struct cast* c = calloc(1, sizeof(*c));
+    if (!c) {
+        return NULL;
+    }
+    c->f        = f;
+    c->start_us = time_us();
+    c->front    = malloc(MAX_CAST);
+    c->back     = malloc(MAX_CAST);
+    bool ok     = c->front && c->back && monitor_init(&c->lock);
+    if (ok && !thread_start(&c->thread, cast_run, c)) {
+        monitor_free(&c->lock);
+        ok = false;
+    }
+    if (!ok) {
+        free(c->front);
+        free(c->back);
+        free(c);
+        return NULL;
+    }
+    return c;
+}
+
+// write pending frames, end writer thread and free recorder, f is not closed
+static inline void cast_close(struct cast* c) {
+    if (!c) {
+        return;
+    }
+    monitor_lock(&c->lock);
+    c->stop = true;
+    monitor_signal(&c->lock);
+    monitor_unlock(&c->lock);
+    thread_join(&c->thread);
+    monitor_free(&c->lock);
+    free(c->front);
+    free(c->back);
+    free(c);
+}
+
+/* pager **********************************************************************/
+
+// The indexer thread owns the mapping and writes line starts past count
+// without the lock. It takes the lock to grow the index, to publish count and
+// to remap a file that changed size. A file that shrunk is indexed again from
+// the start. The element reads the index and the mapping while holding the
+// lock.
+
+#define PAGER_CHUNK (1 << 20) // bytes scanned between index updates
+#define PAGER_POLL  100       // ms between checks for file growth
+#define PAGER_LINES 4096      // offsets allocated at first, doubled as needed
+
+struct pager {
+    struct state*  ctx;     // context woken up by index updates
+    const char*    data;    // mapped file
+    int64_t        size;    // mapped bytes
+    int64_t*       lines;   // byte offsets of line starts
+    int64_t        count;   // indexed lines
+    int64_t        cap;     // offsets allocated for lines
+    int64_t        scanned; // bytes scanned, indexer only
+    bool           pending; // last scanned byte is a newline, indexer only
+    bool           stop;    // indexer ends
+    bool           follow;  // keep end of file visible
+    int64_t        total;   // indexed lines when last drawn
+    int64_t        top;     // first visible line
+    int            left;    // first visible column
+    char           buf[MAX_PAGER]; // visible part of line
+    struct thread  thread;  // indexer
+    struct monitor lock;    // protects data, size, lines, count and stop,
+                            // signaled on stop
+#ifdef TIM_UNIX
+    int fd; // file
+#endif
+#ifdef TIM_WINDOWS
+    HANDLE file; // file
+    HANDLE map;  // file mapping
+#endif
+};
+
+// drop mapping and index of truncated file, lock is held
+static void pager_reset(struct pager* p) {
+#ifdef TIM_UNIX
+    if (p->data) {
+        munmap((void*)p->data, p->size);
+    }
+#endif
+#ifdef TIM_WINDOWS
+    if (p->data) {
+        UnmapViewOfFile(p->data);
+        CloseHandle(p->map);
+    }
+#endif
+    p->data     = NULL;
+    p->size     = 0;
+    p->count    = 1; // first line starts at 0
+    p->scanned  = 0;
+    p->pending  = false;
+    p->lines[0] = 0;
+}
+
+// map file again when its size changed, lock is held
+static void pager_map(struct pager* p) {
+#ifdef TIM_UNIX
+    struct stat st;
+    if (fstat(p->fd, &st)) {
+        return;
+    }
+    if (st.st_size < p->size) {
+        pager_reset(p); // reading past the end of the file raises SIGBUS
+    }
+    if (st.st_size <= p->size) {
+        return;
+    }
+    void* data = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, p->fd, 0);
+    if (data == MAP_FAILED) {
+        return;
+    }
+    if (p->data) {
+        munmap((void*)p->data, p->size);
+    }
+    p->data = data;
+    p->size = st.st_size;
+#endif
+#ifdef TIM_WINDOWS
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(p->file, &size)) {
+        return;
+    }
+    if (size.QuadPart < p->size) {
+        pager_reset(p);
+    }
+    if (size.QuadPart <= p->size) {
+        return;
+    }
+    HANDLE map  = CreateFileMappingA(p->file, NULL, PAGE_READONLY, 0, 0, NULL);
+    void*  data = map ? MapViewOfFile(map, FILE_MAP_READ, 0, 0, 0) : NULL;
+    if (!data) {
+        if (map) {
+            CloseHandle(map);
+        }
+        return;
+    }
+    if (p->data) {
+        UnmapViewOfFile(p->data);
+        CloseHandle(p->map);
+    }
+    p->data = data;
+    p->map  = map;
+    p->size = size.QuadPart;
+#endif
+}
+
+// index of lowest set bit, x is not zero
+static inline int bsf32(uint32_t x) {
+#if defined __GNUC__ || defined __clang__
+    return __builtin_ctz(x);
+#elif defined _MSC_VER
+    unsigned long n = 0;
+    _BitScanForward(&n, x);
+    return n;
+#else
+    int n = 0;
+    for (; !(x & 1); n++, x >>= 1) {}
+    return n;
+#endif
+}
+
+// write offsets following newlines in s[from, to) to out, at most max,
+// returns count and sets end to the first byte not scanned
+static int64_t pager_scan(const char* s, int64_t from, int64_t to,
+                          int64_t* out, int64_t max, int64_t* end) {
+    int64_t n = 0;
+    int64_t i = from;
+#ifdef TIM_SSE2
+    __m128i nl = _mm_set1_epi8('\n');
+    for (; i + 16 <= to && n + 16 <= max; i += 16) {
+        __m128i  v = _mm_loadu_si128((const __m128i*)(s + i));
+        uint32_t m = _mm_movemask_epi8(_mm_cmpeq_epi8(v, nl));
+        for (; m; m &= m - 1) {
+            out[n++] = i + bsf32(m) + 1;
+        }
+    }
+#endif
+    for (; i < to && n < max; i++) {
+        if (s[i] == '\n') {
+            out[n++] = i + 1;
+        }
+    }
+    *end = i;
+    return n;
+}
+
+// indexer thread, scans chunks and waits for growth until stopped
+static void pager_run(void* arg) {
+    struct pager* p         = arg;
+    int64_t       posted_us = 0;
+    while (true) {
+        monitor_lock(&p->lock);
+        if (!p->stop && p->scanned == p->size) {
+            monitor_wait(&p->lock, PAGER_POLL);
+        }
+        pager_map(p); // every chunk, the file may shrink while scanning
+        if (p->stop) {
+            monitor_unlock(&p->lock);
+            return;
+        }
+        int64_t from = p->scanned;
+        int64_t to   = MIN(from + PAGER_CHUNK, p->size);
+        int64_t size = p->size;
+        if (to > from && p->cap - p->count < 64) {
+            int64_t  cap   = p->cap * 2;
+            int64_t* lines = realloc(p->lines, cap * sizeof(*lines));
+            if (!lines) {
+                p->scanned = p->size; // out of memory, index stays partial
+                monitor_unlock(&p->lock);
+                continue;
+            }
+            p->lines = lines;
+            p->cap   = cap;
+        }
+        const char* data = p->data;
+        int64_t*    out  = p->lines + p->count;
+        int64_t     max  = p->cap - p->count;
+        monitor_unlock(&p->lock);
+
+        if (to == from) {
+            continue;
+        }
+        int64_t n = 0;
+        if (p->pending) {
+            out[n++] = from; // newline at end of last scan started a line
+        }
+        // stops early when the index is full, the next round grows it
+        n += pager_scan(data, from, to, out + n, max - n, &to);
+        // newline at end of file only starts a line when more text follows
+        p->pending = n > 0 && out[n - 1] == size;
+        n         -= p->pending;
+
+        monitor_lock(&p->lock);
+        p->count   += n;
+        p->scanned  = to;
+        monitor_unlock(&p->lock);
+
+        // text was scanned even without new lines, a last line may have grown
+        if (to == size || time_us() - posted_us > 50000) {
+            posted_us = time_us();
+            context (p->ctx) {
+                post_event(p);
+            }
+        }
+    }
+}
+
+// map file and start indexer, NULL on error
+static inline struct pager* pager_open(const char* path) {
+    struct pager* p = calloc(1, sizeof(*p));
+    if (!p) {
+        return NULL;
+    }
+    p->ctx   = tim_ctx;
+    p->cap   = PAGER_LINES;
+    p->lines = malloc(p->cap * sizeof(*p->lines));
+    p->count = 1; // first line starts at 0
+    bool ok  = p->lines;
+    if (ok) {
+        p->lines[0] = 0;
+    }
+#ifdef TIM_UNIX
+    p->fd = open(path, O_RDONLY | O_CLOEXEC);
+    ok    = ok && p->fd >= 0;
+#endif
+#ifdef TIM_WINDOWS
+    p->file = CreateFileA(path, GENERIC_READ,
+                          FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                          NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    ok = ok && p->file != INVALID_HANDLE_VALUE;
+#endif
+    if (ok) {
+        pager_map(p);
+    }
+    ok = ok && monitor_init(&p->lock);
+    if (ok && !thread_start(&p->thread, pager_run, p)) {
+        monitor_free(&p->lock);
+        ok = false;
+    }
+    if (!ok) {
+#ifdef TIM_UNIX
+        if (p->data) {
+            munmap((void*)p->data, p->size);
+        }
+        if (p->fd >= 0) {
+            close(p->fd);
+        }
+#endif
+#ifdef TIM_WINDOWS
+        if (p->data) {
+            UnmapViewOfFile(p->data);
+            CloseHandle(p->map);
+        }
+        if (p->file != INVALID_HANDLE_VALUE) {
+            CloseHandle(p->file);
+        }
+#endif
+        free(p->lines);
+        free(p);
+        return NULL;
+    }
+    return p;
+}
+
+// stop indexer, unmap and close file
+static inline void pager_close(struct pager* p) {
+    if (!p) {
+        return;
+    }
+    monitor_lock(&p->lock);
+    p->stop = true;
+    monitor_signal(&p->lock);
+    monitor_unlock(&p->lock);
+    thread_join(&p->thread);
+    monitor_free(&p->lock);
+#ifdef TIM_UNIX
+    if (p->data) {
+        munmap((void*)p->data, p->size);
+    }
+    close(p->fd);
+#endif
+#ifdef TIM_WINDOWS
+    if (p->data) {
+        UnmapViewOfFile(p->data);
+        CloseHandle(p->map);
+    }
+    CloseHandle(p->file);
+#endif
+    free(p->lines);
+    free(p);
+}
+
+// copy visible part of line at offset pos to buf, lock is held
+static const char* pager_line(struct pager* p, int64_t pos, int w) {
+    int n    = 0;
+    int skip = p->left;
+    while (pos < p->size && p->data[pos] != '\n' && n + 5 < MAX_PAGER &&
+           w > 0) {
+        uint8_t c = p->data[pos];
+        int     k = MIN(MAX(bsr8(~c), 1), 4); // utf8 length
+        k         = MIN(k, p->size - pos);
+        if (skip > 0) {
+            skip -= 1;
+        } else if (c < ' ' || c == 127) {
+            p->buf[n++] = ' '; // tabs and other control characters
+            w          -= 1;
+        } else {
+            memcpy(p->buf + n, p->data + pos, k);
+            n += k;
+            w -= 1;
+        }
+        pos += k;
+    }
+    p->buf[n] = 0;
+    return p->buf;
+}
+
+static void pager_event(struct pager* p, struct rect r) {
+    if (tim.event.type == MOUSE_EVENT && is_mouse_over(r)) {
+        switch (tim.event.key) {
+        case WHEEL_UP:
+            p->top   -= LIST_WHEEL;
+            p->follow = false;
+            tim.event.type = VOID_EVENT; // consume event
+            return;
+        case WHEEL_DOWN:
+            p->top   += LIST_WHEEL;
+            tim.event.type = VOID_EVENT;
+            return;
+        case LEFT_BUTTON:
+            tim.focus = (uintptr_t)p; // take focus
+            return;
+        }
+    }
+
+    if (tim.focus != (uintptr_t)p || tim.event.type != KEY_EVENT) {
+        // not focused or no key press
+        return;
+    }
+
+    switch (tim.event.key) {
+    case ESCAPE_KEY:
+        tim.focus = 0; // release focus
+        break;
+    case UP_KEY:
+        p->top   -= 1;
+        p->follow = false;
+        break;
+    case DOWN_KEY:
+        p->top += 1;
+        break;
+    case PAGEUP_KEY:
+        p->top   -= r.h;
+        p->follow = false;
+        break;
+    case PAGEDOWN_KEY:
+        p->top += r.h;
+        break;
+    case HOME_KEY:
+        p->top    = 0;
+        p->follow = false;
+        break;
+    case END_KEY:
+        p->follow = true;
+        break;
+    case LEFT_KEY:
+        p->left = MAX(p->left - 8, 0);
+        break;
+    case RIGHT_KEY:
+        p->left += 8;
+        break;
+    default:
+        return; // leave other keys to other handlers
+    }
+    tim.event.type = VOID_EVENT; // consume event
+}
+
+// file pager
+// p    : pager from pager_open
+// color: background, text
+static inline void pager(struct pager* p, int x, int y, int w, int h,
+                         uint64_t color) {
+    int64_t     t = probe_begin();
+    struct rect r = abs_xywh(x, y, w, h);
+
+    monitor_lock(&p->lock);
+    int64_t count = p->count;
+    p->total      = count;
+    pager_event(p, r);
+    p->top = p->follow ? count - r.h : p->top;
+    p->top = MAX(MIN(p->top, count - 1), 0);
+
+    if (tim.event.type == DRAW_EVENT && !is_clipped(r)) {
+        struct rect c = clip_rect(r, tim.clips[tim.scope]);
+        draw_lot(cell(" ", color, color >> 8), r.x, r.y, r.w, r.h);
+        for (int i = c.y - r.y; i < c.y + c.h - r.y; i++) {
+            if (p->top + i < count) {
+                const char* s = pager_line(p, p->lines[p->top + i], r.w);
+                draw_str(s, r.x, r.y + i, r.w, color, color >> 8);
+            }
+        }
+    }
+    monitor_unlock(&p->lock);
+
+    probe_end("pager", r, t);
+}
+
+/* filter *********************************************************************/
+
+// Workers claim chunks of candidates and score them without the lock, then
+// take the lock to append matches to results, which has room for all
+// candidates and is only replaced by the element. Slots below nresults are
+// final, so the element merges them into the top matches without the lock.
+// Stale workers drop their matches when the generation changed.
+
+#define FILTER_CHUNK   16384 // candidates claimed at once
+#define FILTER_THREADS 8     // max worker threads
+
+struct scan {
+    struct filter* owner;     // filter posted with progress
+    struct state*  ctx;       // context woken up by progress
+    char           query[MAX_QUERY]; // query of current job, lowercase
+    int            gen;       // job generation
+    int            count;     // items of current job
+    int*           cand;      // candidate items, NULL for all items
+    int            ncand;     // number of candidates
+    int            next;      // next candidate to claim
+    int            active;    // workers scoring a chunk
+    struct match*  results;   // matches of current job
+    int            nresults;  // number of results
+    int            merged;    // results merged into top, element only
+    bool           stop;      // workers end
+    int64_t        posted_us; // time of last progress event
+    int            threads;   // number of workers
+    struct thread  thread[FILTER_THREADS]; // workers
+    struct monitor lock;      // protects all above, signaled on new job,
+                              // idle workers or stop
+};
+
+static inline char lower_ascii(char c) {
+    return (c >= 'A' && c <= 'Z') ? c + 32 : c;
+}
+
+// first occurrence of lowercase c in s ignoring ascii case, NULL when absent
+static const char* find_ci(const char* s, char c) {
+    char u = (c >= 'a' && c <= 'z') ? c - 32 : c;
+#if defined TIM_SSE2 && !defined TIM_ASAN
+    // aligned loads never cross a page, bytes before s are masked out
+    const char* p    = s - ((uintptr_t)s & 15);
+    uint32_t    skip = ~0u << ((uintptr_t)s & 15);
+    __m128i     z    = _mm_setzero_si128();
+    __m128i     vl   = _mm_set1_epi8(c);
+    __m128i     vu   = _mm_set1_epi8(u);
+    for (;; p += 16, skip = ~0u) {
+        __m128i  v   = _mm_load_si128((const __m128i*)p);
+        __m128i  lo  = _mm_cmpeq_epi8(v, vl);
+        __m128i  up  = _mm_cmpeq_epi8(v, vu);
+        uint32_t end = _mm_movemask_epi8(_mm_cmpeq_epi8(v, z)) & skip;
+        uint32_t hit = _mm_movemask_epi8(_mm_or_si128(lo, up)) & skip;
+        if (hit | end) {
+            hit &= end ? (end ^ (end - 1)) : ~0u; // hits up to terminator
+            return hit ? p + bsf32(hit) : NULL;
+        }
+    }
+#else
+    for (; *s; s++) {
+        if (*s == c || *s == u) {
+            return s;
+        }
+    }
+    return NULL;
+#endif
+}
+
+// score of greedy fuzzy match of lowercase q in s, -1 when q is no subsequence
+static int fuzzy_score(const char* s, const char* q) {
+    int         score = 0;
+    const char* start = s;
+    const char* prev  = NULL;
+    for (; *q; q++) {
+        const char* p = find_ci(s, *q);
+        if (!p) {
+            return -1;
+        }
+        char b = (p > start) ? lower_ascii(p[-1]) : ' ';
+        score += 16;
+        if (prev && p == prev + 1) {
+            score += 8; // consecutive
+        } else if (!((b >= 'a' && b <= 'z') || (b >= '0' && b <= '9'))) {
+            score += 8; // word start
+        }
+        score -= MIN(p - s, 8); // gap
+        prev   = p;
+        s      = p + 1;
+    }
+    return score;
+}
+
+// a ranks before b
+static inline bool match_before(struct match a, struct match b) {
+    return a.score > b.score || (a.score == b.score && a.index < b.index);
+}
+
+// worker thread, scores claimed chunks of candidates until stopped
+static void scan_run(void* arg) {
+    struct scan*  s   = arg;
+    int*          idx = malloc(FILTER_CHUNK * sizeof(*idx));
+    struct match* out = malloc(FILTER_CHUNK * sizeof(*out));
+    char          q[MAX_QUERY];
+    monitor_lock(&s->lock);
+    while (!s->stop) {
+        if (!idx || !out || s->next >= s->ncand) {
+            monitor_wait(&s->lock, -1);
+            continue;
+        }
+        int gen  = s->gen;
+        int from = s->next;
+        int n    = MIN(FILTER_CHUNK, s->ncand - from);
+        s->next += n;
+        s->active++;
+        for (int i = 0; i < n; i++) {
+            idx[i] = s->cand ? s->cand[from + i] : from + i;
+        }
+        memcpy(q, s->query, MAX_QUERY);
+        const char* (*item)(int, void*) = s->owner->item;
+        void* data = s->owner->data;
+        monitor_unlock(&s->lock);
+
+        int k = 0;
+        for (int i = 0; i < n; i++) {
+            int score = fuzzy_score(item(idx[i], data), q);
+            if (score >= 0) {
+                out[k++] = (struct match){idx[i], score};
+            }
+        }
+
+        monitor_lock(&s->lock);
+        if (!--s->active) {
+            monitor_signal(&s->lock); // restart may wait for idle workers
+        }
+        bool stale = gen != s->gen; // query changed while scoring
+        if (!stale) {
+            memcpy(s->results + s->nresults, out, k * sizeof(*out));
+            s->nresults += k;
+        }
+        // the last worker out posts completion, stale or not
+        bool done = s->next >= s->ncand && !s->active;
+        if (done || (!stale && k > 0 && time_us() - s->posted_us > 50000)) {
+            s->posted_us = time_us();
+            context (s->ctx) {
+                post_event(s->owner);
+            }
+        }
+    }
+    monitor_unlock(&s->lock);
+    free(idx);
+    free(out);
+}
+
+// start workers, one per core, NULL on error
+static struct scan* scan_open(struct filter* f) {
+    struct scan* s = calloc(1, sizeof(*s));
+    if (!s) {
+        return NULL;
+    }
+    s->owner = f;
+    s->ctx   = tim_ctx;
+#ifdef TIM_UNIX
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+#ifdef TIM_WINDOWS
+    SYSTEM_INFO si;
+    GetSystemInfo(&si);
+    int cores = si.dwNumberOfProcessors;
+#endif
+    if (!monitor_init(&s->lock)) {
+        free(s);
+        return NULL;
+    }
+    for (int i = 0; i < MIN(MAX(cores, 1), FILTER_THREADS); i++) {
+        if (!thread_start(&s->thread[i], scan_run, s)) {
+            break;
+        }
+        s->threads++;
+    }
+    if (!s->threads) {
+        monitor_free(&s->lock);
+        free(s);
+        return NULL;
+    }
+    return s;
+}
+
+// stop workers and free matches
+static inline void filter_free(struct filter* f) {
+    struct scan* s = f->scan;
+    if (s) {
+        monitor_lock(&s->lock);
+        s->stop = true;
+        monitor_signal(&s->lock);
+        monitor_unlock(&s->lock);
+        for (int i = 0; i < s->threads; i++) {
+            thread_join(&s->thread[i]);
+        }
+        monitor_free(&s->lock);
+        free(s->cand);
+        free(s->results);
+        free(s);
+    }
+    free(f->top);
+    *f = (struct filter){.item = f->item, .data = f->data};
+}
+
+// a is a subsequence of b
+static bool is_subsequence(const char* a, const char* b) {
+    for (; *a && *b; b++) {
+        a += *a == *b;
+    }
+    return !*a;
+}
+
+// start scan of query q over count items, lock is held
+static void filter_restart(struct filter* f, const char* q, int count) {
+    struct scan* s  = f->scan;
+    bool done       = s->next >= s->ncand && !s->active;
+    // matches of an extended query are among the matches of the old one
+    bool refine     = done && s->query[0] && s->count == count &&
+                      is_subsequence(s->query, q);
+    if (count != s->count) {
+        // items past the new count may be gone, let workers finish chunks
+        s->next = s->ncand;
+        while (s->active) {
+            monitor_wait(&s->lock, -1);
+        }
+    }
+    int           n = refine ? s->nresults : count;
+    int*          cand = NULL;
+    struct match* results = malloc(MAX(n, 1) * sizeof(*results));
+    if (refine && results) {
+        cand = malloc(MAX(n, 1) * sizeof(*cand));
+        for (int i = 0; cand && i < n; i++) {
+            cand[i] = s->results[i].index;
+        }
+        if (!cand) {
+            free(results);
+            results = NULL;
+        }
+    }
+    free(s->cand);
+    free(s->results);
+    s->cand     = cand;
+    s->results  = results;
+    s->ncand    = (results && q[0]) ? n : 0; // empty query shows all items
+    s->count    = count;
+    s->next     = 0;
+    s->nresults = 0;
+    s->merged   = 0;
+    s->gen++;
+    snprintf(s->query, MAX_QUERY, "%s", q);
+    f->top_count = 0;
+    f->list      = (struct list){0};
+    monitor_signal(&s->lock);
+}
+
+// insert m into sorted top matches, dropping the worst beyond MAX_MATCH
+static void filter_insert(struct filter* f, struct match m) {
+    int n = f->top_count;
+    if (n == MAX_MATCH && !match_before(m, f->top[n - 1])) {
+        return;
+    }
+    int lo = 0;
+    int hi = n;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (match_before(f->top[mid], m)) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    n = MIN(n, MAX_MATCH - 1);
+    memmove(f->top + lo + 1, f->top + lo, (n - lo) * sizeof(*f->top));
+    f->top[lo]   = m;
+    f->top_count = n + 1;
+}
+
+static void filter_row(int i, bool selected, void* data) {
+    struct filter* f = data;
+    struct rect    r = tim.scopes[tim.scope];
+    int item = f->scan->query[0] ? f->top[i].index : i;
+    draw_lot(cell(" ", f->color, f->color >> 8), r.x, r.y, r.w, 1);
+    draw_str(f->item(item, f->data), r.x, r.y, r.w, f->color, f->color >> 8);
+    if (selected) {
+        draw_invert(r.x, r.y, r.w);
+    }
+}
+
+// selected item of filter, -1 when nothing matches
+static inline int filter_selected(struct filter* f) {
+    if (!f->scan || !f->scan->query[0]) {
+        return (f->scan && f->list.selected < f->scan->count)
+               ? f->list.selected : -1;
+    }
+    return f->list.selected < f->top_count ? f->top[f->list.selected].index
+                                           : -1;
+}
+
+// fuzzy filter - returns true when a match is clicked or return is pressed
+// f    : persistent filter state with item callback
+// query: edit with the query, drawn after the filter
+// color: background, text
+static inline bool filter(struct filter* f, struct edit* query, int count,
+                          int x, int y, int w, int h, uint64_t color) {
+    int64_t     t = probe_begin();
+    struct rect r = abs_xywh(x, y, w, h);
+    bool        ret = false;
+
+    if (!f->top) {
+        f->top  = malloc(MAX_MATCH * sizeof(*f->top));
+        f->scan = f->top ? scan_open(f) : NULL;
+    }
+    if (!f->scan) {
+        probe_end("filter", r, t);
+        return false;
+    }
+    struct scan* s = f->scan;
+
+    char q[MAX_QUERY];
+    int  n = 0;
+    for (const char* c = edit_str(query); *c && n < MAX_QUERY - 1; c++) {
+        q[n++] = lower_ascii(*c);
+    }
+    q[n] = 0;
+
+    monitor_lock(&s->lock);
+    if (s->gen == 0 || count != s->count || strcmp(q, s->query)) {
+        filter_restart(f, q, count);
+    }
+    int ready = s->nresults;
+    f->done   = s->next >= s->ncand && !s->active;
+    monitor_unlock(&s->lock);
+
+    // stream new matches into the top matches
+    for (; s->merged < ready; s->merged++) {
+        filter_insert(f, s->results[s->merged]);
+    }
+    f->matches = ready;
+
+    // navigation keys reach the list while the query is edited
+    bool nav = tim.event.type == KEY_EVENT &&
+               tim.focus == (uintptr_t)query &&
+               (tim.event.key == UP_KEY || tim.event.key == DOWN_KEY ||
+                tim.event.key == PAGEUP_KEY || tim.event.key == PAGEDOWN_KEY ||
+                tim.event.key == ENTER_KEY);
+    if (nav) {
+        tim.focus = (uintptr_t)&f->list;
+    }
+    f->color = color;
+    ret      = list(&f->list, q[0] ? f->top_count : count, filter_row, f, x,
+                    y, w, h, color);
+    if (nav) {
+        tim.focus = (uintptr_t)query;
+    }
+
+    probe_end("filter", r, t);
+    return ret;
+}